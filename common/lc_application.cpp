@@ -2,6 +2,7 @@
 #include <stdio.h>
 #include "lc_application.h"
 #include "lc_library.h"
+#include "lc_meshoptimizer.h"
 #include "lc_profile.h"
 #include "project.h"
 #include "lc_mainwindow.h"
@@ -748,6 +749,14 @@ lcCommandLineOptions lcApplication::ParseCommandLineOptions()
 			Options.SaveHTML = true;
 			ParseString(Options.SaveHTMLName, false);
 		}
+		else if (Option == QLatin1String("--verbose"))
+		{
+			Options.Verbose = true;
+		}
+		else if (Option == QLatin1String("--mesh-stats"))
+		{
+			Options.MeshStats = true;
+		}
 		else if (Option == QLatin1String("-v") || Option == QLatin1String("--version"))
 		{
 #ifdef LC_CONTINUOUS_BUILD
@@ -803,6 +812,8 @@ lcCommandLineOptions lcApplication::ParseCommandLineOptions()
 			Options.StdOut += tr("  -dae, --export-collada <outfile.dae>: Export the model to COLLADA DAE format.\n");
 			Options.StdOut += tr("  -csv, --export-csv <outfile.csv>: Export the list of parts used in csv format.\n");
 			Options.StdOut += tr("  -html, --export-html <folder>: Create an HTML page for the model.\n");
+			Options.StdOut += tr("  --verbose: Output additional information such as loading times.\n");
+			Options.StdOut += tr("  --mesh-stats: Build the mesh of every part in the library, output mesh statistics and exit.\n");
 			Options.StdOut += tr("  -v, --version: Output version information and exit.\n");
 			Options.StdOut += tr("  -?, --help: Display this help message and exit.\n");
 			Options.StdOut += QLatin1String("\n");
@@ -929,7 +940,7 @@ lcStartupMode lcApplication::Initialize(const QList<QPair<QString, bool>>& Libra
 		return lcStartupMode::Error;
 	}
 
-	const bool SaveAndExit = (Options.SaveImage || Options.SaveWavefront || Options.Save3DS || Options.SaveCOLLADA || Options.SaveCSV || Options.SaveHTML);
+	const bool SaveAndExit = (Options.SaveImage || Options.SaveWavefront || Options.Save3DS || Options.SaveCOLLADA || Options.SaveCSV || Options.SaveHTML || Options.MeshStats);
 
 	if (!SaveAndExit)
 	{
@@ -941,6 +952,9 @@ lcStartupMode lcApplication::Initialize(const QList<QPair<QString, bool>>& Libra
 		lcLoadDefaultMouseShortcuts();
 	}
 
+	QElapsedTimer LibraryTimer;
+	LibraryTimer.start();
+
 	if (!LoadPartsLibrary(Options.LibraryPaths.isEmpty() ? LibraryPaths : Options.LibraryPaths, !Options.LibraryPaths.isEmpty()))
 	{
 		QString Message;
@@ -959,6 +973,12 @@ lcStartupMode lcApplication::Initialize(const QList<QPair<QString, bool>>& Libra
 		}
 	}
 
+	if (Options.Verbose)
+	{
+		StdOut << tr("Loaded %1 parts from the Parts Library in %2 ms.\n").arg(mLibrary->mPieces.size()).arg(LibraryTimer.elapsed());
+		StdOut.flush();
+	}
+
 	mPreferences.mShadingMode = Options.ShadingMode;
 	mPreferences.mLineWidth = Options.LineWidth;
 	mPreferences.mStudCylinderColorEnabled = Options.StudCylinderColorEnabled;
@@ -975,6 +995,32 @@ lcStartupMode lcApplication::Initialize(const QList<QPair<QString, bool>>& Libra
 
 	lcGetPiecesLibrary()->SetStudStyle(Options.StudStyle, false, Options.StudCylinderColorEnabled);
 
+	if (Options.MeshStats)
+	{
+		// Skip the piece cache so every mesh goes through the optimizer and is counted.
+		mLibrary->SetReadPieceCache(false);
+
+		for (const auto& PieceIt : mLibrary->mPieces)
+		{
+			PieceInfo* Info = PieceIt.second;
+
+			mLibrary->LoadPieceInfo(Info, true, false);
+			mLibrary->ReleasePieceInfo(Info);
+		}
+
+		const lcMeshLoaderStats& MeshLoaderStats = mLibrary->GetLoadStats().MeshLoader;
+		const qint64 Triangles = MeshLoaderStats.OptimizedTriangles;
+		const double ACMRBefore = Triangles ? static_cast<double>(MeshLoaderStats.CacheMissesBefore) / Triangles : 0.0;
+		const double ACMRAfter = Triangles ? static_cast<double>(MeshLoaderStats.CacheMissesAfter) / Triangles : 0.0;
+
+		StdOut << tr("Built %1 part meshes with %2 triangles.\n").arg(mLibrary->mPieces.size()).arg(Triangles);
+		StdOut << tr("Vertex cache ACMR (%1 entry FIFO): %2 before optimization, %3 after.\n").arg(LC_VERTEX_CACHE_FIFO_SIZE).arg(ACMRBefore, 0, 'f', 3).arg(ACMRAfter, 0, 'f', 3);
+		StdOut << tr("Generated textured vertices for %1 parts in %2 ms.\n").arg(MeshLoaderStats.TexturedMeshes).arg(MeshLoaderStats.TexturedVertexTime / 1000000.0, 0, 'f', 1);
+		StdOut.flush();
+
+		return lcStartupMode::Success;
+	}
+
 	if (!SaveAndExit)
 		gMainWindow->CreateWidgets();
 
@@ -1231,6 +1277,27 @@ lcStartupMode lcApplication::Initialize(const QList<QPair<QString, bool>>& Libra
 		}
 	}
 
+	if (SaveAndExit && Options.Verbose)
+	{
+		const lcPieceLoadStats LoadStats = mLibrary->GetLoadStats();
+		const double PiecesPerSecond = LoadStats.LoadTime ? LoadStats.PiecesLoaded * 1000.0 / LoadStats.LoadTime : 0.0;
+
+		StdOut << tr("Loaded %1 pieces in the background in %2 ms (%3 pieces per second, peak queue depth %4).\n").arg(LoadStats.PiecesLoaded).arg(LoadStats.LoadTime).arg(PiecesPerSecond, 0, 'f', 1).arg(LoadStats.PeakQueueDepth);
+
+		const lcMeshLoaderStats& MeshLoaderStats = LoadStats.MeshLoader;
+		const int SubfileReferences = MeshLoaderStats.VertexCacheHits + MeshLoaderStats.VertexCacheMisses;
+		const double HitRate = SubfileReferences ? MeshLoaderStats.VertexCacheHits * 100.0 / SubfileReferences : 0.0;
+
+		StdOut << tr("Mesh loader vertex cache: %1 hits, %2 misses (%3% hit rate), %4 translation only references.\n").arg(MeshLoaderStats.VertexCacheHits).arg(MeshLoaderStats.VertexCacheMisses).arg(HitRate, 0, 'f', 1).arg(MeshLoaderStats.TranslationOnly);
+
+		const lcLibraryMemoryStats MemoryStats = mLibrary->GetMemoryStats();
+		const auto ToKB = [](qint64 Bytes) { return (Bytes + 1023) / 1024; };
+
+		StdOut << tr("Piece memory: %1 KB vertices, %2 KB indices, %3 KB primitives, %4 KB textures, budget %5 KB.\n").arg(ToKB(MemoryStats.VertexBytes)).arg(ToKB(MemoryStats.IndexBytes)).arg(ToKB(MemoryStats.PrimitiveBytes)).arg(ToKB(MemoryStats.TextureBytes)).arg(ToKB(MemoryStats.Budget));
+		StdOut << tr("Evicted %1 unused pieces and %2 primitives, %3 unused pieces still cached.\n").arg(MemoryStats.EvictedPieces).arg(MemoryStats.EvictedPrimitives).arg(MemoryStats.UnusedPieces);
+		StdOut.flush();
+	}
+
 	if (!SaveAndExit)
 	{
 		gMainWindow->SetColorIndex(lcGetColorIndex(7));
@@ -123,6 +123,8 @@ struct lcCommandLineOptions
 	bool FadeSteps = false;
 	bool ImageHighlight = false;
 	bool AutomateEdgeColor = false;
+	bool Verbose = false;
+	bool MeshStats = false;
 	int ImageWidth;
 	int ImageHeight;
 	int AASamples;
@@ -25,10 +25,16 @@
 #define GL_STATIC_DRAW_ARB GL_STATIC_DRAW
 #endif
 
+#define LC_OBJECT_DATA_TEXTURE_UNIT 1
+
 std::unique_ptr<QOpenGLContext> lcContext::mOffscreenContext;
 std::unique_ptr<QOffscreenSurface> lcContext::mOffscreenSurface;
 std::unique_ptr<lcContext> lcContext::mGlobalOffscreenContext;
 lcProgram lcContext::mPrograms[static_cast<int>(lcMaterialType::Count)];
+GLuint lcContext::mInstanceBufferObject;
+GLuint lcContext::mObjectBufferObject;
+GLuint lcContext::mObjectTexture;
+GLint lcContext::mMaxObjectDataSize;
 
 lcContext::lcContext()
 {
@@ -66,6 +72,9 @@ lcContext::lcContext()
 	mHighlightParams[1] = lcVector4(0.0f, 0.0f, 0.0f, 0.0f);
 	mHighlightParams[2] = lcVector4(0.0f, 0.0f, 0.0f, 0.0f);
 	mHighlightParams[3] = lcVector4(0.0f, 0.0f, 0.0f, 0.0f);
+	mObjectOffsets[0] = 0;
+	mObjectOffsets[1] = 0;
+	mObjectOffsetsDirty = false;
 	mColorDirty = false;
 	mWorldMatrixDirty = false;
 	mViewMatrixDirty = false;
@@ -177,7 +186,7 @@ void lcContext::DestroyOffscreenContext()
 
 void lcContext::CreateShaderPrograms()
 {
-	const char* ShaderPrefix =
+	const char* ShaderVersion =
 	{
 #ifndef LC_OPENGLES
 "#version 110\n"
@@ -197,7 +206,24 @@ void lcContext::CreateShaderPrograms()
 "#define LC_PIXEL_OUTPUT out mediump vec4 gl_FragColor;\n"
 "#define LC_SHADER_PRECISION mediump\n"
 #endif
+	};
+
+	// Programs that read per-object data from a texture buffer need GLSL 3.30.
+	const char* ObjectShaderVersion =
+	{
+"#version 330\n"
+"#define mediump\n"
+"#define texture2D texture\n"
+"#define LC_VERTEX_INPUT in\n"
+"#define LC_VERTEX_OUTPUT out\n"
+"#define LC_PIXEL_INPUT in\n"
+"#define gl_FragColor FragColor\n"
+"#define LC_PIXEL_OUTPUT out vec4 gl_FragColor;\n"
+"#define LC_SHADER_PRECISION\n"
+	};
 
+	const char* ShaderCommon =
+	{
 "#define LC_PIXEL_FAKE_LIGHTING \\\n"
 "		LC_SHADER_PRECISION vec3 Normal = normalize(PixelNormal); \\\n"
 "		LC_SHADER_PRECISION vec3 LightDirection = normalize(PixelPosition - LightPosition); \\\n"
@@ -218,7 +244,11 @@ void lcContext::CreateShaderPrograms()
 		":/resources/shaders/unlit_vertex_color_vs.glsl",      // UnlitVertexColor
 		":/resources/shaders/unlit_view_sphere_vs.glsl",       // UnlitViewSphere
 		":/resources/shaders/fakelit_color_vs.glsl",           // FakeLitColor
-		":/resources/shaders/fakelit_texture_decal_vs.glsl"    // FakeLitTextureDecal
+		":/resources/shaders/fakelit_texture_decal_vs.glsl",   // FakeLitTextureDecal
+		":/resources/shaders/unlit_color_instanced_vs.glsl",   // UnlitColorInstanced
+		":/resources/shaders/fakelit_color_instanced_vs.glsl", // FakeLitColorInstanced
+		":/resources/shaders/unlit_color_object_vs.glsl",      // UnlitColorObject
+		":/resources/shaders/fakelit_color_object_vs.glsl"     // FakeLitColorObject
 	};
 
 	LC_ARRAY_SIZE_CHECK(VertexShaders, lcMaterialType::Count);
@@ -232,19 +262,23 @@ void lcContext::CreateShaderPrograms()
 		":/resources/shaders/unlit_vertex_color_ps.glsl",      // UnlitVertexColor
 		":/resources/shaders/unlit_view_sphere_ps.glsl",       // UnlitViewSphere
 		":/resources/shaders/fakelit_color_ps.glsl",           // FakeLitColor
-		":/resources/shaders/fakelit_texture_decal_ps.glsl"    // FakeLitTextureDecal
+		":/resources/shaders/fakelit_texture_decal_ps.glsl",   // FakeLitTextureDecal
+		":/resources/shaders/unlit_vertex_color_ps.glsl",      // UnlitColorInstanced
+		":/resources/shaders/fakelit_color_instanced_ps.glsl", // FakeLitColorInstanced
+		":/resources/shaders/unlit_vertex_color_ps.glsl",      // UnlitColorObject
+		":/resources/shaders/fakelit_color_instanced_ps.glsl"  // FakeLitColorObject
 	};
 
 	LC_ARRAY_SIZE_CHECK(FragmentShaders, lcMaterialType::Count);
 
-	const auto LoadShader = [this, ShaderPrefix](const char* FileName, GLuint ShaderType) -> GLuint
+	const auto LoadShader = [this, ShaderCommon](const char* FileName, GLuint ShaderType, const char* ShaderPrefix) -> GLuint
 	{
 		QFile ShaderFile(FileName);
 
 		if (!ShaderFile.open(QIODevice::ReadOnly))
 			return 0;
 
-		QByteArray Data = ShaderPrefix + ShaderFile.readAll();
+		QByteArray Data = ShaderPrefix + QByteArray(ShaderCommon) + ShaderFile.readAll();
 		const char* Source = Data.constData();
 
 		const GLuint Shader = glCreateShader(ShaderType);
@@ -273,8 +307,17 @@ void lcContext::CreateShaderPrograms()
 
 	for (int MaterialType = 0; MaterialType < static_cast<int>(lcMaterialType::Count); MaterialType++)
 	{
-		const GLuint VertexShader = LoadShader(VertexShaders[MaterialType], GL_VERTEX_SHADER);
-		const GLuint FragmentShader = LoadShader(FragmentShaders[MaterialType], GL_FRAGMENT_SHADER);
+		const bool ObjectMaterial = MaterialType == static_cast<int>(lcMaterialType::UnlitColorObject) || MaterialType == static_cast<int>(lcMaterialType::FakeLitColorObject);
+
+		if (ObjectMaterial && !gSupportsObjectBuffer)
+		{
+			mPrograms[MaterialType].Object = 0;
+			continue;
+		}
+
+		const char* ShaderPrefix = ObjectMaterial ? ObjectShaderVersion : ShaderVersion;
+		const GLuint VertexShader = LoadShader(VertexShaders[MaterialType], GL_VERTEX_SHADER, ShaderPrefix);
+		const GLuint FragmentShader = LoadShader(FragmentShaders[MaterialType], GL_FRAGMENT_SHADER, ShaderPrefix);
 
 		GLuint Program = glCreateProgram();
 
@@ -291,6 +334,12 @@ void lcContext::CreateShaderPrograms()
 		glBindAttribLocation(Program, static_cast<int>(lcProgramAttrib::ControlPoint3), "VertexPosition3");
 		glBindAttribLocation(Program, static_cast<int>(lcProgramAttrib::ControlPoint4), "VertexPosition4");
 
+		glBindAttribLocation(Program, static_cast<int>(lcProgramAttrib::InstanceWorldMatrix0), "InstanceWorldMatrix0");
+		glBindAttribLocation(Program, static_cast<int>(lcProgramAttrib::InstanceWorldMatrix1), "InstanceWorldMatrix1");
+		glBindAttribLocation(Program, static_cast<int>(lcProgramAttrib::InstanceWorldMatrix2), "InstanceWorldMatrix2");
+		glBindAttribLocation(Program, static_cast<int>(lcProgramAttrib::InstanceWorldMatrix3), "InstanceWorldMatrix3");
+		glBindAttribLocation(Program, static_cast<int>(lcProgramAttrib::InstanceColor), "InstanceColor");
+
 		glLinkProgram(Program);
 
 		glDetachShader(Program, VertexShader);
@@ -316,6 +365,8 @@ void lcContext::CreateShaderPrograms()
 
 		mPrograms[MaterialType].Object = Program;
 		mPrograms[MaterialType].WorldViewProjectionMatrixLocation = glGetUniformLocation(Program, "WorldViewProjectionMatrix");
+		mPrograms[MaterialType].ViewProjectionMatrixLocation = glGetUniformLocation(Program, "ViewProjectionMatrix");
+		mPrograms[MaterialType].ObjectOffsetsLocation = glGetUniformLocation(Program, "ObjectOffsets");
 		mPrograms[MaterialType].WorldMatrixLocation = glGetUniformLocation(Program, "WorldMatrix");
 		mPrograms[MaterialType].MaterialColorLocation = glGetUniformLocation(Program, "MaterialColor");
 		mPrograms[MaterialType].LightPositionLocation = glGetUniformLocation(Program, "LightPosition");
@@ -330,6 +381,15 @@ void lcContext::CreateShaderPrograms()
 			glUniform1i(TextureLocation, 0);
 			glUseProgram(0);
 		}
+
+		const GLint ObjectDataLocation = glGetUniformLocation(Program, "ObjectData");
+
+		if (ObjectDataLocation != -1)
+		{
+			glUseProgram(Program);
+			glUniform1i(ObjectDataLocation, LC_OBJECT_DATA_TEXTURE_UNIT);
+			glUseProgram(0);
+		}
 	}
 }
 
@@ -339,6 +399,25 @@ void lcContext::CreateResources()
 		return;
 
 	CreateShaderPrograms();
+
+	if (gSupportsInstancing)
+		glGenBuffers(1, &mInstanceBufferObject);
+
+#ifndef LC_OPENGLES
+	if (gSupportsObjectBuffer)
+	{
+		glGenBuffers(1, &mObjectBufferObject);
+		glBindBuffer(GL_TEXTURE_BUFFER, mObjectBufferObject);
+		glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+		glGenTextures(1, &mObjectTexture);
+		glBindTexture(GL_TEXTURE_BUFFER, mObjectTexture);
+		gTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, mObjectBufferObject);
+		glBindTexture(GL_TEXTURE_BUFFER, 0);
+
+		glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &mMaxObjectDataSize);
+	}
+#endif
 }
 
 void lcContext::DestroyResources()
@@ -351,6 +430,21 @@ void lcContext::DestroyResources()
 		glDeleteProgram(mPrograms[MaterialType].Object);
 		mPrograms[MaterialType].Object = 0;
 	}
+
+	if (mInstanceBufferObject)
+	{
+		glDeleteBuffers(1, &mInstanceBufferObject);
+		mInstanceBufferObject = 0;
+	}
+
+	if (mObjectBufferObject)
+	{
+		glDeleteTextures(1, &mObjectTexture);
+		mObjectTexture = 0;
+		glDeleteBuffers(1, &mObjectBufferObject);
+		mObjectBufferObject = 0;
+		mMaxObjectDataSize = 0;
+	}
 }
 
 void lcContext::MakeCurrent()
@@ -498,6 +592,19 @@ void lcContext::ClearResources()
 	ClearTexture2D();
 }
 
+void lcContext::UploadObjectData()
+{
+#ifndef LC_OPENGLES
+	glBindBuffer(GL_TEXTURE_BUFFER, mObjectBufferObject);
+	glBufferData(GL_TEXTURE_BUFFER, mObjectData.size() * sizeof(lcVector4), mObjectData.data(), GL_STREAM_DRAW);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+	glActiveTexture(GL_TEXTURE0 + LC_OBJECT_DATA_TEXTURE_UNIT);
+	glBindTexture(GL_TEXTURE_BUFFER, mObjectTexture);
+	glActiveTexture(GL_TEXTURE0);
+#endif
+}
+
 void lcContext::SetMaterial(lcMaterialType MaterialType)
 {
 	if (MaterialType == mMaterialType)
@@ -512,6 +619,7 @@ void lcContext::SetMaterial(lcMaterialType MaterialType)
 		mWorldMatrixDirty = true; // todo: change dirty to a bitfield and set the lighting constants dirty here
 		mViewMatrixDirty = true;
 		mHighlightParamsDirty = true;
+		mObjectOffsetsDirty = true;
 	}
 	else
 	{
@@ -543,6 +651,10 @@ void lcContext::SetMaterial(lcMaterialType MaterialType)
 		case lcMaterialType::UnlitColorConditional:
 		case lcMaterialType::UnlitVertexColor:
 		case lcMaterialType::FakeLitColor:
+		case lcMaterialType::UnlitColorInstanced:
+		case lcMaterialType::FakeLitColorInstanced:
+		case lcMaterialType::UnlitColorObject:
+		case lcMaterialType::FakeLitColorObject:
 			if (mTextureEnabled)
 			{
 				glDisable(GL_TEXTURE_2D);
@@ -883,13 +995,27 @@ lcVertexBuffer lcContext::CreateVertexBuffer(int Size, const void* Data)
 	else
 	{
 		VertexBuffer.Pointer = malloc(Size);
-		if (VertexBuffer.Pointer)
+		if (VertexBuffer.Pointer && Data)
 			memcpy(VertexBuffer.Pointer, Data, Size);
 	}
 
 	return VertexBuffer;
 }
 
+void lcContext::UpdateVertexBuffer(lcVertexBuffer& VertexBuffer, int Offset, int Size, const void* Data)
+{
+	if (gSupportsVertexBufferObject)
+	{
+		glBindBuffer(GL_ARRAY_BUFFER_ARB, VertexBuffer.Object);
+		glBufferSubData(GL_ARRAY_BUFFER_ARB, Offset, Size, Data);
+
+		glBindBuffer(GL_ARRAY_BUFFER_ARB, 0); // context remove
+		mVertexBufferObject = 0;
+	}
+	else
+		memcpy((char*)VertexBuffer.Pointer + Offset, Data, Size);
+}
+
 void lcContext::DestroyVertexBuffer(lcVertexBuffer& VertexBuffer)
 {
 	if (!VertexBuffer.IsValid())
@@ -929,13 +1055,27 @@ lcIndexBuffer lcContext::CreateIndexBuffer(int Size, const void* Data)
 	else
 	{
 		IndexBuffer.Pointer = malloc(Size);
-		if (IndexBuffer.Pointer)
+		if (IndexBuffer.Pointer && Data)
 			memcpy(IndexBuffer.Pointer, Data, Size);
 	}
 
 	return IndexBuffer;
 }
 
+void lcContext::UpdateIndexBuffer(lcIndexBuffer& IndexBuffer, int Offset, int Size, const void* Data)
+{
+	if (gSupportsVertexBufferObject)
+	{
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER_ARB, IndexBuffer.Object);
+		glBufferSubData(GL_ELEMENT_ARRAY_BUFFER_ARB, Offset, Size, Data);
+
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER_ARB, 0); // context remove
+		mIndexBufferObject = 0;
+	}
+	else
+		memcpy((char*)IndexBuffer.Pointer + Offset, Data, Size);
+}
+
 void lcContext::DestroyIndexBuffer(lcIndexBuffer& IndexBuffer)
 {
 	if (!IndexBuffer.IsValid())
@@ -1118,24 +1258,54 @@ void lcContext::SetVertexFormatPosition(int PositionSize)
 	}
 }
 
-void lcContext::SetVertexFormatConditional(int BufferOffset)
+void lcContext::SetVertexFormatConditional(int BufferOffset, bool Compact)
 {
-	constexpr int VertexSize = 12 * sizeof(float);
+	const GLenum PositionType = Compact ? GL_SHORT : GL_FLOAT;
+	const int PositionSize = Compact ? 4 * sizeof(qint16) : 3 * sizeof(float);
+	const int VertexSize = 4 * PositionSize;
 	const char* VertexBufferPointer = mVertexBufferPointer + BufferOffset;
 
 	if (gSupportsShaderObjects)
 	{
-		SetVertexAttribPointer(lcProgramAttrib::ControlPoint1, 3, GL_FLOAT, false, VertexSize, VertexBufferPointer);
+		SetVertexAttribPointer(lcProgramAttrib::ControlPoint1, 3, PositionType, false, VertexSize, VertexBufferPointer);
 		EnableVertexAttrib(lcProgramAttrib::ControlPoint1);
-		SetVertexAttribPointer(lcProgramAttrib::ControlPoint2, 3, GL_FLOAT, false, VertexSize, VertexBufferPointer + 3 * sizeof(float));
+		SetVertexAttribPointer(lcProgramAttrib::ControlPoint2, 3, PositionType, false, VertexSize, VertexBufferPointer + PositionSize);
 		EnableVertexAttrib(lcProgramAttrib::ControlPoint2);
-		SetVertexAttribPointer(lcProgramAttrib::ControlPoint3, 3, GL_FLOAT, false, VertexSize, VertexBufferPointer + 6 * sizeof(float));
+		SetVertexAttribPointer(lcProgramAttrib::ControlPoint3, 3, PositionType, false, VertexSize, VertexBufferPointer + 2 * PositionSize);
 		EnableVertexAttrib(lcProgramAttrib::ControlPoint3);
-		SetVertexAttribPointer(lcProgramAttrib::ControlPoint4, 3, GL_FLOAT, false, VertexSize, VertexBufferPointer + 9 * sizeof(float));
+		SetVertexAttribPointer(lcProgramAttrib::ControlPoint4, 3, PositionType, false, VertexSize, VertexBufferPointer + 3 * PositionSize);
 		EnableVertexAttrib(lcProgramAttrib::ControlPoint4);
 	}
 }
 
+void lcContext::SetVertexFormatCompact(int BufferOffset, int TexCoordSize, bool EnableNormals)
+{
+	const int VertexSize = 4 * sizeof(qint16) + sizeof(quint32) + TexCoordSize * sizeof(float);
+	const char* VertexBufferPointer = mVertexBufferPointer + BufferOffset;
+
+	// Compact meshes are only uploaded when shaders are available.
+	SetVertexAttribPointer(lcProgramAttrib::Position, 3, GL_SHORT, false, VertexSize, VertexBufferPointer);
+	EnableVertexAttrib(lcProgramAttrib::Position);
+
+	if (EnableNormals)
+	{
+		SetVertexAttribPointer(lcProgramAttrib::Normal, 4, GL_BYTE, true, VertexSize, VertexBufferPointer + 4 * sizeof(qint16));
+		EnableVertexAttrib(lcProgramAttrib::Normal);
+	}
+	else
+		DisableVertexAttrib(lcProgramAttrib::Normal);
+
+	if (TexCoordSize)
+	{
+		SetVertexAttribPointer(lcProgramAttrib::TexCoord, TexCoordSize, GL_FLOAT, false, VertexSize, VertexBufferPointer + 4 * sizeof(qint16) + sizeof(quint32));
+		EnableVertexAttrib(lcProgramAttrib::TexCoord);
+	}
+	else
+		DisableVertexAttrib(lcProgramAttrib::TexCoord);
+
+	DisableVertexAttrib(lcProgramAttrib::Color);
+}
+
 void lcContext::SetVertexFormat(int BufferOffset, int PositionSize, int NormalSize, int TexCoordSize, int ColorSize, bool EnableNormals)
 {
 	const int VertexSize = (PositionSize + TexCoordSize) * sizeof(float) + NormalSize * sizeof(quint32) + ColorSize;
@@ -1362,7 +1532,11 @@ void lcContext::FlushState()
 					glUniform3fv(Program.EyePositionLocation, 1, ViewPosition);
 			}
 
-			glUniformMatrix4fv(Program.WorldViewProjectionMatrixLocation, 1, false, lcMul(mWorldMatrix, mViewProjectionMatrix));
+			if (Program.ViewProjectionMatrixLocation != -1 && (mViewMatrixDirty || mProjectionMatrixDirty))
+				glUniformMatrix4fv(Program.ViewProjectionMatrixLocation, 1, false, mViewProjectionMatrix);
+
+			if (Program.WorldViewProjectionMatrixLocation != -1)
+				glUniformMatrix4fv(Program.WorldViewProjectionMatrixLocation, 1, false, lcMul(mWorldMatrix, mViewProjectionMatrix));
 			mWorldMatrixDirty = false;
 			mViewMatrixDirty = false;
 			mProjectionMatrixDirty = false;
@@ -1374,6 +1548,12 @@ void lcContext::FlushState()
 			mColorDirty = false;
 		}
 
+		if (mObjectOffsetsDirty && Program.ObjectOffsetsLocation != -1)
+		{
+			glUniform2i(Program.ObjectOffsetsLocation, mObjectOffsets[0], mObjectOffsets[1]);
+			mObjectOffsetsDirty = false;
+		}
+
 		if (mHighlightParamsDirty && Program.HighlightParamsLocation != -1)
 		{
 			glUniform4fv(Program.HighlightParamsLocation, 4, mHighlightParams[0]);
@@ -1424,3 +1604,29 @@ void lcContext::DrawIndexedPrimitives(GLenum Mode, GLsizei Count, GLenum Type, i
 	FlushState();
 	glDrawElements(Mode, Count, Type, mIndexBufferPointer + Offset);
 }
+
+void lcContext::DrawIndexedPrimitivesInstanced(GLenum Mode, GLsizei Count, GLenum Type, int Offset, const lcInstanceData* Instances, int InstanceCount)
+{
+	QOpenGLExtraFunctions* ExtraFunctions = mContext->extraFunctions();
+	const int FirstAttrib = static_cast<int>(lcProgramAttrib::InstanceWorldMatrix0);
+	const int LastAttrib = static_cast<int>(lcProgramAttrib::InstanceColor);
+
+	// Replacing the whole buffer lets the driver hand out new storage instead of waiting for the previous draw.
+	glBindBuffer(GL_ARRAY_BUFFER_ARB, mInstanceBufferObject);
+	glBufferData(GL_ARRAY_BUFFER_ARB, InstanceCount * sizeof(lcInstanceData), Instances, GL_STREAM_DRAW);
+
+	for (int AttribIndex = FirstAttrib; AttribIndex <= LastAttrib; AttribIndex++)
+	{
+		glVertexAttribPointer(AttribIndex, 4, GL_FLOAT, false, sizeof(lcInstanceData), (const char*)nullptr + (AttribIndex - FirstAttrib) * sizeof(lcVector4));
+		glEnableVertexAttribArray(AttribIndex);
+		ExtraFunctions->glVertexAttribDivisor(AttribIndex, 1);
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER_ARB, mVertexBufferObject);
+
+	FlushState();
+	ExtraFunctions->glDrawElementsInstanced(Mode, Count, Type, mIndexBufferPointer + Offset, InstanceCount);
+
+	for (int AttribIndex = FirstAttrib; AttribIndex <= LastAttrib; AttribIndex++)
+		glDisableVertexAttribArray(AttribIndex);
+}
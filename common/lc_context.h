@@ -55,6 +55,10 @@ enum class lcMaterialType
 	UnlitViewSphere,
 	FakeLitColor,
 	FakeLitTextureDecal,
+	UnlitColorInstanced,
+	FakeLitColorInstanced,
+	UnlitColorObject,
+	FakeLitColorObject,
 	Count
 };
 
@@ -68,13 +72,26 @@ enum class lcProgramAttrib
 	ControlPoint2,
 	ControlPoint3,
 	ControlPoint4,
+	InstanceWorldMatrix0,
+	InstanceWorldMatrix1,
+	InstanceWorldMatrix2,
+	InstanceWorldMatrix3,
+	InstanceColor,
 	Count
 };
 
+struct lcInstanceData
+{
+	lcMatrix44 WorldMatrix;
+	lcVector4 Color;
+};
+
 struct lcProgram
 {
 	GLuint Object;
 	GLint WorldViewProjectionMatrixLocation;
+	GLint ViewProjectionMatrixLocation;
+	GLint ObjectOffsetsLocation;
 	GLint WorldMatrixLocation;
 	GLint MaterialColorLocation;
 	GLint LightPositionLocation;
@@ -160,6 +177,37 @@ public:
 		return mProjectionMatrix;
 	}
 
+	void ClearObjectData()
+	{
+		mObjectData.clear();
+	}
+
+	int AddObjectMatrix(const lcMatrix44& Matrix)
+	{
+		const int Offset = static_cast<int>(mObjectData.size());
+		mObjectData.insert(mObjectData.end(), Matrix.r, Matrix.r + 4);
+		return Offset;
+	}
+
+	void AddObjectColor(const lcVector4& Color)
+	{
+		mObjectData.push_back(Color);
+	}
+
+	void SetObjectOffsets(int MatrixOffset, int ColorOffset)
+	{
+		mObjectOffsets[0] = MatrixOffset;
+		mObjectOffsets[1] = ColorOffset;
+		mObjectOffsetsDirty = true;
+	}
+
+	void UploadObjectData();
+
+	int GetMaxObjectDataSize() const
+	{
+		return mMaxObjectDataSize;
+	}
+
 	void SetMaterial(lcMaterialType MaterialType);
 	void SetViewport(int x, int y, int Width, int Height);
 	void SetPolygonOffset(lcPolygonOffset PolygonOffset);
@@ -200,8 +248,10 @@ public:
 	void SetEdgeColorIndexTinted(int ColorIndex, const lcVector4& Tint);
 
 	lcVertexBuffer CreateVertexBuffer(int Size, const void* Data);
+	void UpdateVertexBuffer(lcVertexBuffer& VertexBuffer, int Offset, int Size, const void* Data);
 	void DestroyVertexBuffer(lcVertexBuffer& VertexBuffer);
 	lcIndexBuffer CreateIndexBuffer(int Size, const void* Data);
+	void UpdateIndexBuffer(lcIndexBuffer& IndexBuffer, int Offset, int Size, const void* Data);
 	void DestroyIndexBuffer(lcIndexBuffer& IndexBuffer);
 
 	void ClearVertexBuffer();
@@ -214,9 +264,11 @@ public:
 
 	void SetVertexFormat(int BufferOffset, int PositionSize, int NormalSize, int TexCoordSize, int ColorSize, bool EnableNormals);
 	void SetVertexFormatPosition(int PositionSize);
-	void SetVertexFormatConditional(int BufferOffset);
+	void SetVertexFormatConditional(int BufferOffset, bool Compact);
+	void SetVertexFormatCompact(int BufferOffset, int TexCoordSize, bool EnableNormals);
 	void DrawPrimitives(GLenum Mode, GLint First, GLsizei Count);
 	void DrawIndexedPrimitives(GLenum Mode, GLsizei Count, GLenum Type, int Offset);
+	void DrawIndexedPrimitivesInstanced(GLenum Mode, GLsizei Count, GLenum Type, int Offset, const lcInstanceData* Instances, int InstanceCount);
 
 	void BindMesh(const lcMesh* Mesh);
 
@@ -266,6 +318,9 @@ protected:
 	lcMatrix44 mProjectionMatrix;
 	lcMatrix44 mViewProjectionMatrix;
 	lcVector4 mHighlightParams[4];
+	std::vector<lcVector4> mObjectData;
+	GLint mObjectOffsets[2];
+	bool mObjectOffsetsDirty;
 	bool mColorDirty;
 	bool mWorldMatrixDirty;
 	bool mViewMatrixDirty;
@@ -278,6 +333,10 @@ protected:
 	static std::unique_ptr<lcContext> mGlobalOffscreenContext;
 
 	static lcProgram mPrograms[static_cast<int>(lcMaterialType::Count)];
+	static GLuint mInstanceBufferObject;
+	static GLuint mObjectBufferObject;
+	static GLuint mObjectTexture;
+	static GLint mMaxObjectDataSize;
 
 	Q_DECLARE_TR_FUNCTIONS(lcContext);
 };
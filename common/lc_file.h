@@ -38,6 +38,11 @@ public:
 	virtual size_t ReadBuffer(void* Buffer, size_t Bytes) = 0;
 	virtual size_t WriteBuffer(const void* Buffer, size_t Bytes) = 0;
 
+	virtual const char* Map()
+	{
+		return nullptr;
+	}
+
 	quint8 ReadU8()
 	{
 		quint8 Value;
@@ -477,6 +482,11 @@ public:
 	size_t ReadBuffer(void* Buffer, size_t Bytes) override;
 	size_t WriteBuffer(const void* Buffer, size_t Bytes) override;
 
+	const char* Map() override
+	{
+		return (const char*)mBuffer;
+	}
+
 	void GrowFile(size_t NewLength);
 
 	size_t mGrowBytes;
@@ -559,6 +569,11 @@ public:
 		return mFile.write((const char*)Buffer, Bytes);
 	}
 
+	const char* Map() override
+	{
+		return (const char*)mFile.map(0, mFile.size());
+	}
+
 	bool Open(QIODevice::OpenMode Flags)
 	{
 		return mFile.open(Flags);
@@ -6,9 +6,15 @@ bool gSupportsShaderObjects;
 bool gSupportsVertexBufferObject;
 bool gSupportsFramebufferObject;
 bool gSupportsBlendFuncSeparate;
+bool gSupportsInstancing;
+bool gSupportsObjectBuffer;
 bool gSupportsAnisotropic;
 GLfloat gMaxAnisotropy;
 
+#ifndef LC_OPENGLES
+PFNGLTEXBUFFERPROC gTexBuffer;
+#endif
+
 #if !defined(QT_NO_DEBUG) && defined(GL_ARB_debug_output)
 
 static void APIENTRY lcGLDebugCallback(GLenum Source, GLenum Type, GLuint Id, GLenum Severity, GLsizei Length, const GLchar* Message, GLvoid* UserParam)
@@ -58,4 +64,18 @@ void lcInitializeGLExtensions(const QOpenGLContext* Context)
 	gSupportsFramebufferObject = Functions->hasOpenGLFeature(QOpenGLFunctions::Framebuffers);
 	gSupportsBlendFuncSeparate = Functions->hasOpenGLFeature(QOpenGLFunctions::BlendFuncSeparate);
 	gSupportsShaderObjects = Functions->hasOpenGLFeature(QOpenGLFunctions::Shaders);
+
+	const QSurfaceFormat Format = Context->format();
+
+	if (Context->isOpenGLES())
+		gSupportsInstancing = gSupportsShaderObjects && Format.majorVersion() >= 3;
+	else
+		gSupportsInstancing = gSupportsShaderObjects && Format.version() >= qMakePair(3, 3);
+
+#ifndef LC_OPENGLES
+	if (gSupportsInstancing)
+		gTexBuffer = (PFNGLTEXBUFFERPROC)Context->getProcAddress("glTexBuffer");
+
+	gSupportsObjectBuffer = gSupportsInstancing && gTexBuffer;
+#endif
 }
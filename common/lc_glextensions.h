@@ -6,5 +6,11 @@ extern bool gSupportsShaderObjects;
 extern bool gSupportsVertexBufferObject;
 extern bool gSupportsFramebufferObject;
 extern bool gSupportsBlendFuncSeparate;
+extern bool gSupportsInstancing;
+extern bool gSupportsObjectBuffer;
 extern bool gSupportsAnisotropic;
 extern GLfloat gMaxAnisotropy;
+
+#ifndef LC_OPENGLES
+extern PFNGLTEXBUFFERPROC gTexBuffer;
+#endif
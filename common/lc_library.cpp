@@ -24,9 +24,89 @@
 #  define DEF_MEM_LEVEL	 MAX_MEM_LEVEL
 #endif
 
-#define LC_LIBRARY_CACHE_VERSION   0x0109
+#define LC_LIBRARY_CACHE_VERSION   0x010A
 #define LC_LIBRARY_CACHE_ARCHIVE   0x0001
 #define LC_LIBRARY_CACHE_DIRECTORY 0x0002
+#define LC_LIBRARY_CACHE_PACK      0x0004
+
+#define LC_LIBRARY_CACHE_ENTRY_ID        LC_FOURCC('P', 'A', 'R', 'T')
+#define LC_LIBRARY_CACHE_ENTRY_ALIGNMENT 64
+#define LC_LIBRARY_CACHE_PAGE_SIZE       4096
+#define LC_LIBRARY_CACHE_MAX_DEAD_RATIO  4
+#define LC_LIBRARY_CACHE_LOCK_TIMEOUT    1000
+
+struct lcLibraryCacheFileHeader
+{
+	quint32 Version;
+	quint32 Flags;
+	quint32 MeshVersion;
+	quint32 Reserved;
+	qint64 CheckSum[4];
+};
+
+struct lcLibraryCacheEntryHeader
+{
+	quint32 Id;
+	quint32 Size;
+	qint32 Flags;
+	quint32 NameLength;
+	quint32 MeshOffset;
+	quint32 MeshSize;
+	quint32 VertexDataOffset;
+	quint32 VertexDataSize;
+	quint32 IndexDataOffset;
+	quint32 IndexDataSize;
+};
+
+static qint64 lcAlignCacheOffset(qint64 Offset, qint64 Alignment)
+{
+	return (Offset + Alignment - 1) & ~(Alignment - 1);
+}
+
+static QByteArray lcCreateCacheEntry(qint64 Offset, qint32 Flags, const char* Name, quint32 NameLength, const void* MeshData, quint32 MeshSize, const void* VertexData, quint32 VertexDataSize, const void* IndexData, quint32 IndexDataSize)
+{
+	lcLibraryCacheEntryHeader EntryHeader;
+
+	EntryHeader.Id = LC_LIBRARY_CACHE_ENTRY_ID;
+	EntryHeader.Flags = Flags;
+	EntryHeader.NameLength = NameLength;
+	EntryHeader.MeshOffset = sizeof(EntryHeader) + NameLength;
+	EntryHeader.MeshSize = MeshSize;
+	EntryHeader.VertexDataOffset = (quint32)(lcAlignCacheOffset(Offset + EntryHeader.MeshOffset + MeshSize, LC_LIBRARY_CACHE_PAGE_SIZE) - Offset);
+	EntryHeader.VertexDataSize = VertexDataSize;
+	EntryHeader.IndexDataOffset = (quint32)(lcAlignCacheOffset(Offset + EntryHeader.VertexDataOffset + VertexDataSize, LC_LIBRARY_CACHE_ENTRY_ALIGNMENT) - Offset);
+	EntryHeader.IndexDataSize = IndexDataSize;
+	EntryHeader.Size = (quint32)(lcAlignCacheOffset(Offset + EntryHeader.IndexDataOffset + IndexDataSize, LC_LIBRARY_CACHE_ENTRY_ALIGNMENT) - Offset);
+
+	QByteArray EntryData(EntryHeader.Size, 0);
+	char* Data = EntryData.data();
+
+	memcpy(Data, &EntryHeader, sizeof(EntryHeader));
+	memcpy(Data + sizeof(EntryHeader), Name, NameLength);
+	memcpy(Data + EntryHeader.MeshOffset, MeshData, MeshSize);
+	memcpy(Data + EntryHeader.VertexDataOffset, VertexData, VertexDataSize);
+	memcpy(Data + EntryHeader.IndexDataOffset, IndexData, IndexDataSize);
+
+	return EntryData;
+}
+
+class lcPieceLoadThread : public QThread
+{
+public:
+	lcPieceLoadThread(lcPiecesLibrary* Library, int ThreadIndex)
+		: mLibrary(Library), mThreadIndex(ThreadIndex)
+	{
+	}
+
+protected:
+	void run() override
+	{
+		mLibrary->ProcessLoadQueue(mThreadIndex);
+	}
+
+	lcPiecesLibrary* mLibrary;
+	int mThreadIndex;
+};
 
 lcPiecesLibrary::lcPiecesLibrary()
 #if (QT_VERSION < QT_VERSION_CHECK(6, 0, 0))
@@ -40,38 +120,75 @@ lcPiecesLibrary::lcPiecesLibrary()
 	Dir.mkpath(mCachePath);
 
 	mNumOfficialPieces = 0;
-	mBuffersDirty = false;
+	mPieceCacheSize = 0;
+	mPieceCacheDeadSize = 0;
 	mHasUnofficial = false;
 	mCancelLoading = false;
 	mStudStyle = static_cast<lcStudStyle>(lcGetProfileInt(LC_PROFILE_STUD_STYLE));
 	mStudCylinderColorEnabled = lcGetProfileInt(LC_PROFILE_STUD_CYLINDER_COLOR_ENABLED);
+	mInstanceStuds = lcGetProfileInt(LC_PROFILE_INSTANCE_STUDS);
+	mReadPieceCache = true;
+	mCompactVertices = lcGetProfileInt(LC_PROFILE_COMPACT_VERTICES);
+
+	mStopLoadThreads = false;
+
+	mNextUnusedStamp = 1;
+
+	// With no budget parts are unloaded as soon as they are released, otherwise unused parts are kept until the budget is exceeded.
+	mMemoryStats.Budget = static_cast<qint64>(lcGetProfileInt(LC_PROFILE_PART_MEMORY_BUDGET)) * 1024 * 1024;
+
+	const int ThreadCount = qMax(QThread::idealThreadCount(), 1);
+
+	for (int ThreadIdx = 0; ThreadIdx < ThreadCount; ThreadIdx++)
+	{
+		mLoadQueues.emplace_back(new lcPieceLoadQueue());
+		mLoadThreads.emplace_back(new lcPieceLoadThread(this, ThreadIdx));
+		mLoadThreads.back()->start();
+	}
 }
 
 lcPiecesLibrary::~lcPiecesLibrary()
 {
-	mLoadMutex.lock();
-	mLoadQueue.clear();
-	mLoadMutex.unlock();
+	ClearLoadQueue();
 	mCancelLoading = true;
 	WaitForLoadQueue();
+
+	mLoadQueueMutex.lock();
+	mStopLoadThreads = true;
+	mLoadQueueCondition.wakeAll();
+	mLoadQueueMutex.unlock();
+
+	for (std::unique_ptr<QThread>& LoadThread : mLoadThreads)
+		LoadThread->wait();
+
 	Unload();
 	ReleaseBuffers();
 }
 
 void lcPiecesLibrary::Unload()
 {
+	mUnusedPieces.clear();
+
 	for (const auto& PieceIt : mPieces)
 		delete PieceIt.second;
 	mPieces.clear();
+	mPieceIndex.Clear();
 
+	mPrimitiveStamp.fetchAndAddRelease(1);
 	mSources.clear();
 
+	mMemoryMutex.lock();
+	mMemoryStats.PrimitiveBytes = 0;
+	mMemoryMutex.unlock();
+
 	for (lcTexture* Texture : mTextures)
 		delete Texture;
 	mTextures.clear();
 
 	mNumOfficialPieces = 0;
 
+	ClosePieceCache();
+
 	for (std::unique_ptr<lcZipFile>& ZipFile : mZipFiles)
 		ZipFile.reset();
 }
@@ -86,6 +203,7 @@ void lcPiecesLibrary::RemoveTemporaryPieces()
 
 		if (Info->IsTemporary() && Info->GetRefCount() == 0)
 		{
+			mPieceIndex.Remove(PieceIt->first.c_str());
 			PieceIt = mPieces.erase(PieceIt);
 			delete Info;
 		}
@@ -100,6 +218,7 @@ void lcPiecesLibrary::RemovePiece(PieceInfo* Info)
 	{
 		if (PieceIt->second == Info)
 		{
+			mPieceIndex.Remove(PieceIt->first.c_str());
 			mPieces.erase(PieceIt);
 			break;
 		}
@@ -113,6 +232,7 @@ void lcPiecesLibrary::RenamePiece(PieceInfo* Info, const char* NewName)
 	{
 		if (PieceIt->second == Info)
 		{
+			mPieceIndex.Remove(PieceIt->first.c_str());
 			mPieces.erase(PieceIt);
 			break;
 		}
@@ -127,7 +247,13 @@ void lcPiecesLibrary::RenamePiece(PieceInfo* Info, const char* NewName)
 	strcpy(PieceName, Info->mFileName);
 	strupr(PieceName);
 
-	mPieces[PieceName] = Info;
+	AddPiece(PieceName, Info);
+}
+
+void lcPiecesLibrary::AddPiece(const char* Name, PieceInfo* Info)
+{
+	mPieces[Name] = Info;
+	mPieceIndex.Insert(Name, Info);
 }
 
 PieceInfo* lcPiecesLibrary::FindPiece(const char* PieceName, Project* CurrentProject, bool CreatePlaceholder, bool SearchProjectFolder)
@@ -141,34 +267,22 @@ PieceInfo* lcPiecesLibrary::FindPiece(const char* PieceName, Project* CurrentPro
 			ProjectPath = QFileInfo(FileName).absolutePath();
 	}
 
-	char CleanName[LC_PIECE_NAME_LEN];
-	const char* Src = PieceName;
-	char* Dst = CleanName;
-
-	while (*Src && Dst - CleanName != sizeof(CleanName))
-	{
-		if (*Src == '\\')
-			*Dst = '/';
-		else if (*Src >= 'a' && *Src <= 'z')
-			*Dst = *Src + 'A' - 'a';
-		else
-			*Dst = *Src;
+	PieceInfo* Info = mPieceIndex.Find(PieceName);
 
-		Src++;
-		Dst++;
-	}
-	*Dst = 0;
-
-	const auto PieceIt = mPieces.find(CleanName);
-
-	if (PieceIt != mPieces.end())
+	if (Info)
 	{
-		PieceInfo* Info = PieceIt->second;
-
 		if ((!CurrentProject || !Info->IsModel() || CurrentProject->GetModels().FindIndex(Info->GetModel()) != -1) && (!ProjectPath.isEmpty() || !Info->IsProject() || Info->IsProjectPiece()))
 			return Info;
 	}
 
+	char CleanName[LC_PIECE_NAME_LEN];
+	const char* Src = PieceName;
+	char* Dst = CleanName;
+
+	while (*Src && Dst - CleanName != sizeof(CleanName) - 1)
+		*Dst++ = lcNameIndex<PieceInfo>::FoldChar(*Src++);
+	*Dst = 0;
+
 	if (!ProjectPath.isEmpty())
 	{
 		QFileInfo ProjectFile = QFileInfo(ProjectPath + QDir::separator() + PieceName);
@@ -179,10 +293,10 @@ PieceInfo* lcPiecesLibrary::FindPiece(const char* PieceName, Project* CurrentPro
 
 			if (NewProject->Load(ProjectFile.absoluteFilePath(), false))
 			{
-				PieceInfo* Info = new PieceInfo();
+				Info = new PieceInfo();
 
 				Info->CreateProject(NewProject, PieceName);
-				mPieces[CleanName] = Info;
+				AddPiece(CleanName, Info);
 
 				return Info;
 			}
@@ -193,10 +307,10 @@ PieceInfo* lcPiecesLibrary::FindPiece(const char* PieceName, Project* CurrentPro
 
 	if (CreatePlaceholder)
 	{
-		PieceInfo* Info = new PieceInfo();
+		Info = new PieceInfo();
 
 		Info->CreatePlaceholder(PieceName);
-		mPieces[CleanName] = Info;
+		AddPiece(CleanName, Info);
 
 		return Info;
 	}
@@ -206,6 +320,8 @@ PieceInfo* lcPiecesLibrary::FindPiece(const char* PieceName, Project* CurrentPro
 
 lcTexture* lcPiecesLibrary::FindTexture(const char* TextureName, Project* CurrentProject, bool SearchProjectFolder)
 {
+	QMutexLocker TextureLock(&mTextureMutex);
+
 	for (lcTexture* Texture : mTextures)
 		if (!strcmp(TextureName, Texture->mName))
 			return Texture;
@@ -253,6 +369,7 @@ bool lcPiecesLibrary::Load(const QString& LibraryPath, bool ShowProgress)
 			UnofficialFileName.clear();
 
 		ReadArchiveDescriptions(LibraryPath, UnofficialFileName);
+		OpenPieceCache();
 	}
 	else
 	{
@@ -448,19 +565,19 @@ bool lcPiecesLibrary::OpenArchive(std::unique_ptr<lcFile> File, lcZipFileType Zi
 					strncpy(Info->mFileName, FileInfo.file_name + (Name - NameBuffer), sizeof(Info->mFileName)-1);
 					Info->mFileName[sizeof(Info->mFileName) - 1] = 0;
 
-					mPieces[Name] = Info;
+					AddPiece(Name, Info);
 				}
 
 				Info->SetZipFile(ZipFileType, FileIdx);
 			}
 			else
-				Source->Primitives[Name] = new lcLibraryPrimitive(QString(), FileInfo.file_name + (Name - NameBuffer), ZipFileType, FileIdx, false, false, true);
+				Source->AddPrimitive(Name, new lcLibraryPrimitive(QString(), FileInfo.file_name + (Name - NameBuffer), ZipFileType, FileIdx, false, false, true));
 		}
 		else if (!memcmp(Name, "P/", 2))
 		{
 			Name += 2;
 
-			Source->Primitives[Name] = new lcLibraryPrimitive(QString(), FileInfo.file_name + (Name - NameBuffer), ZipFileType, FileIdx, IsStudPrimitive(Name), IsStudStylePrimitive(Name), false);
+			Source->AddPrimitive(Name, new lcLibraryPrimitive(QString(), FileInfo.file_name + (Name - NameBuffer), ZipFileType, FileIdx, IsStudPrimitive(Name), IsStudStylePrimitive(Name), false));
 		}
 	}
 
@@ -495,19 +612,38 @@ void lcPiecesLibrary::ReadArchiveDescriptions(const QString& OfficialFileName, c
 
 	QString IndexFileName = QFileInfo(QDir(mCachePath), QLatin1String("index")).absoluteFilePath();
 
-	if (!LoadCacheIndex(IndexFileName))
+	if (LoadCacheIndex(IndexFileName))
+		return;
+
+	std::vector<PieceInfo*> Pieces;
+	Pieces.reserve(mPieces.size());
+
+	for (const auto& PieceIt : mPieces)
+		Pieces.push_back(PieceIt.second);
+
+	const size_t ThreadCount = qMax(QThread::idealThreadCount(), 1);
+	const size_t BatchSize = (Pieces.size() + ThreadCount - 1) / ThreadCount;
+	std::vector<std::pair<size_t, size_t>> Batches;
+
+	for (size_t BatchStart = 0; BatchStart < Pieces.size(); BatchStart += BatchSize)
+		Batches.emplace_back(BatchStart, qMin(BatchStart + BatchSize, Pieces.size()));
+
+	auto ReadDescriptions = [this, &Pieces](const std::pair<size_t, size_t>& Batch)
 	{
 		lcMemFile PieceFile;
 
-		for (const auto& PieceIt : mPieces)
+		for (size_t PieceIdx = Batch.first; PieceIdx < Batch.second; PieceIdx++)
 		{
-			PieceInfo* Info = PieceIt.second;
+			PieceInfo* Info = Pieces[PieceIdx];
+			const int ZipFileIdx = static_cast<int>(Info->mZipFileType);
+
+			if (ZipFileIdx >= static_cast<int>(lcZipFileType::Count) || !mZipFiles[ZipFileIdx] || !mZipFiles[ZipFileIdx]->ExtractFile(Info->mZipFileIndex, PieceFile, 256))
+				PieceFile.SetLength(0);
 
-			mZipFiles[static_cast<int>(Info->mZipFileType)]->ExtractFile(Info->mZipFileIndex, PieceFile, 256);
 			PieceFile.Seek(0, SEEK_END);
 			PieceFile.WriteU8(0);
 
-			char* Src = (char*)PieceFile.mBuffer + 2;
+			char* Src = (char*)PieceFile.mBuffer + qMin(PieceFile.GetLength() - 1, (size_t)2);
 			char* Dst = Info->m_strDescription;
 
 			for (;;)
@@ -522,9 +658,11 @@ void lcPiecesLibrary::ReadArchiveDescriptions(const QString& OfficialFileName, c
 				break;
 			}
 		}
+	};
 
-		SaveArchiveCacheIndex(IndexFileName);
-	}
+	QtConcurrent::blockingMap(Batches, ReadDescriptions);
+
+	SaveArchiveCacheIndex(IndexFileName);
 }
 
 bool lcPiecesLibrary::OpenDirectory(const QDir& LibraryDir, bool ShowProgress)
@@ -597,7 +735,7 @@ bool lcPiecesLibrary::OpenDirectory(const QDir& LibraryDir, bool ShowProgress)
 					mHasUnofficial = true;
 
 				const bool SubFile = SubFileDirectories[DirectoryIdx];
-				Source->Primitives[Name] = new lcLibraryPrimitive(std::move(FileName), strchr(FileString, '/') + 1, lcZipFileType::Count, 0, !SubFile && IsStudPrimitive(Name), IsStudStylePrimitive(Name), SubFile);
+				Source->AddPrimitive(Name, new lcLibraryPrimitive(std::move(FileName), strchr(FileString, '/') + 1, lcZipFileType::Count, 0, !SubFile && IsStudPrimitive(Name), IsStudStylePrimitive(Name), SubFile));
 			}
 		}
 
@@ -704,7 +842,7 @@ void lcPiecesLibrary::ReadDirectoryDescriptions(const QFileInfoList (&FileLists)
 			}
 			*Dst = 0;
 
-			if (FolderIdx > 0 && mPieces.find(Name) != mPieces.end())
+			if (FolderIdx > 0 && mPieceIndex.Find(Name))
 				continue;
 
 			PieceInfo* Info = new PieceInfo();
@@ -714,7 +852,7 @@ void lcPiecesLibrary::ReadDirectoryDescriptions(const QFileInfoList (&FileLists)
 			Info->mFolderType = FolderIdx;
 			Info->mFolderIndex = FileIdx;
 
-			mPieces[Name] = Info;
+			AddPiece(Name, Info);
 		}
 	}
 
@@ -1110,23 +1248,191 @@ bool lcPiecesLibrary::SaveArchiveCacheIndex(const QString& FileName)
 	return WriteArchiveCacheFile(FileName, IndexFile);
 }
 
-bool lcPiecesLibrary::LoadCachePiece(PieceInfo* Info)
+bool lcPiecesLibrary::OpenPieceCache()
 {
-	QString FileName = QFileInfo(QDir(mCachePath), QString::fromLatin1(Info->mFileName)).absoluteFilePath();
-	lcMemFile MeshData;
+	ClosePieceCache();
+
+	QMutexLocker CacheLock(&mPieceCacheMutex);
+
+	mPieceCacheFile.setFileName(QFileInfo(QDir(mCachePath), QLatin1String("parts")).absoluteFilePath());
+
+	// The pack is shared by every running instance, only one of them can validate, rebuild or append to it at a time.
+	QLockFile FileLock(mPieceCacheFile.fileName() + QLatin1String(".lock"));
 
-	if (!ReadArchiveCacheFile(FileName, MeshData))
+	if (!FileLock.tryLock(LC_LIBRARY_CACHE_LOCK_TIMEOUT))
 		return false;
 
-	qint32 Flags;
-	if (MeshData.ReadBuffer((char*)&Flags, sizeof(Flags)) == 0)
+	if (!LoadPieceCacheEntries())
+		return CompactPieceCache() && LoadPieceCacheEntries();
+
+	if (mPieceCacheDeadSize > mPieceCacheSize / LC_LIBRARY_CACHE_MAX_DEAD_RATIO && CompactPieceCache())
+		return LoadPieceCacheEntries();
+
+	return true;
+}
+
+bool lcPiecesLibrary::LoadPieceCacheEntries()
+{
+	mPieceCacheEntries.clear();
+	mPieceCacheSize = 0;
+	mPieceCacheDeadSize = 0;
+
+	if (!mPieceCacheFile.open(QIODevice::ReadWrite))
 		return false;
 
-	if (Flags != static_cast<qint32>(mStudStyle) + static_cast<qint32>(mStudCylinderColorEnabled))
+	const qint64 FileSize = mPieceCacheFile.size();
+	const qint64 FirstEntryOffset = lcAlignCacheOffset(sizeof(lcLibraryCacheFileHeader), LC_LIBRARY_CACHE_ENTRY_ALIGNMENT);
+	lcLibraryCacheFileHeader FileHeader;
+
+	bool Valid = FileSize >= FirstEntryOffset && mPieceCacheFile.read((char*)&FileHeader, sizeof(FileHeader)) == sizeof(FileHeader);
+	Valid = Valid && FileHeader.Version == LC_LIBRARY_CACHE_VERSION && FileHeader.Flags == LC_LIBRARY_CACHE_PACK && FileHeader.MeshVersion == LC_MESH_FILE_VERSION;
+	Valid = Valid && !memcmp(FileHeader.CheckSum, mArchiveCheckSum, sizeof(mArchiveCheckSum));
+
+	// Meshes point straight into the mapping, keep it private so they can never write to the file.
+	uchar* Data = Valid ? mPieceCacheFile.map(0, FileSize, QFileDevice::MapPrivateOption) : nullptr;
+
+	// Other instances may still have an outdated pack mapped, the caller replaces it with a new file instead of truncating it.
+	if (!Data)
+	{
+		mPieceCacheFile.close();
 		return false;
+	}
+
+	qint64 Offset = FirstEntryOffset;
+
+	while (Offset + (qint64)sizeof(lcLibraryCacheEntryHeader) <= FileSize)
+	{
+		const lcLibraryCacheEntryHeader* EntryHeader = reinterpret_cast<const lcLibraryCacheEntryHeader*>(Data + Offset);
+
+		if (EntryHeader->Id != LC_LIBRARY_CACHE_ENTRY_ID || EntryHeader->Size < sizeof(lcLibraryCacheEntryHeader) || Offset + EntryHeader->Size > FileSize)
+			break;
+
+		if (sizeof(lcLibraryCacheEntryHeader) + EntryHeader->NameLength > EntryHeader->MeshOffset || (quint64)EntryHeader->MeshOffset + EntryHeader->MeshSize > EntryHeader->Size ||
+			(quint64)EntryHeader->VertexDataOffset + EntryHeader->VertexDataSize > EntryHeader->Size || (quint64)EntryHeader->IndexDataOffset + EntryHeader->IndexDataSize > EntryHeader->Size)
+			break;
+
+		std::string Name(reinterpret_cast<const char*>(EntryHeader + 1), EntryHeader->NameLength);
+		lcLibraryCacheEntry& Entry = mPieceCacheEntries[Name];
+
+		mPieceCacheDeadSize += Entry.Size;
+		Entry = { Offset, EntryHeader->Size, EntryHeader->Flags, Data + Offset };
+
+		Offset += EntryHeader->Size;
+	}
+
+	// A partly written entry left by an instance that crashed ends the scan, anything after it can't be reached.
+	mPieceCacheDeadSize += FileSize - Offset;
+	mPieceCacheSize = FileSize;
+
+	return true;
+}
+
+bool lcPiecesLibrary::CompactPieceCache()
+{
+	const QString FileName = mPieceCacheFile.fileName();
+	const QString CompactFileName = FileName + QLatin1String(".new");
+	QFile CompactFile(CompactFileName);
+
+	if (!CompactFile.open(QIODevice::WriteOnly | QIODevice::Truncate))
+		return false;
+
+	const qint64 FirstEntryOffset = lcAlignCacheOffset(sizeof(lcLibraryCacheFileHeader), LC_LIBRARY_CACHE_ENTRY_ALIGNMENT);
+	lcLibraryCacheFileHeader FileHeader;
+
+	memset(&FileHeader, 0, sizeof(FileHeader));
+	FileHeader.Version = LC_LIBRARY_CACHE_VERSION;
+	FileHeader.Flags = LC_LIBRARY_CACHE_PACK;
+	FileHeader.MeshVersion = LC_MESH_FILE_VERSION;
+	memcpy(FileHeader.CheckSum, mArchiveCheckSum, sizeof(mArchiveCheckSum));
+
+	QByteArray HeaderData(FirstEntryOffset, 0);
+	memcpy(HeaderData.data(), &FileHeader, sizeof(FileHeader));
+	bool Success = CompactFile.write(HeaderData) == FirstEntryOffset;
+	qint64 Offset = FirstEntryOffset;
+
+	for (const auto& EntryIt : mPieceCacheEntries)
+	{
+		if (!Success)
+			break;
+
+		const uchar* Data = EntryIt.second.Data;
+		const lcLibraryCacheEntryHeader* EntryHeader = reinterpret_cast<const lcLibraryCacheEntryHeader*>(Data);
+
+		// Entries are laid out again for their new offset so the vertex data stays page aligned.
+		const QByteArray EntryData = lcCreateCacheEntry(Offset, EntryHeader->Flags, reinterpret_cast<const char*>(EntryHeader + 1), EntryHeader->NameLength, Data + EntryHeader->MeshOffset, EntryHeader->MeshSize,
+		                                                Data + EntryHeader->VertexDataOffset, EntryHeader->VertexDataSize, Data + EntryHeader->IndexDataOffset, EntryHeader->IndexDataSize);
+
+		Success = CompactFile.write(EntryData) == EntryData.size();
+		Offset += EntryData.size();
+	}
+
+	CompactFile.close();
+
+	if (!Success)
+	{
+		QFile::remove(CompactFileName);
+		return false;
+	}
+
+	mPieceCacheEntries.clear();
+	mPieceCacheFile.close();
+
+	// Removing the old pack only unlinks it, instances that still have it mapped keep reading valid data.
+	QFile::remove(FileName);
+
+	if (!QFile::rename(CompactFileName, FileName))
+	{
+		QFile::remove(CompactFileName);
+		return false;
+	}
+
+	return true;
+}
+
+void lcPiecesLibrary::ClosePieceCache()
+{
+	QMutexLocker CacheLock(&mPieceCacheMutex);
+
+	mPieceCacheEntries.clear();
+	mPieceCacheFile.close();
+	mPieceCacheSize = 0;
+	mPieceCacheDeadSize = 0;
+}
+
+bool lcPiecesLibrary::LoadCachePiece(PieceInfo* Info)
+{
+	QMutexLocker CacheLock(&mPieceCacheMutex);
+
+	const auto EntryIt = mPieceCacheEntries.find(Info->mFileName);
+
+	if (EntryIt == mPieceCacheEntries.end())
+		return false;
+
+	lcLibraryCacheEntry& Entry = EntryIt->second;
+
+	if (Entry.Flags != static_cast<qint32>(mStudStyle) + static_cast<qint32>(mStudCylinderColorEnabled))
+		return false;
+
+	if (!Entry.Data)
+	{
+		Entry.Data = mPieceCacheFile.map(Entry.Offset, Entry.Size, QFileDevice::MapPrivateOption);
+
+		if (!Entry.Data)
+			return false;
+	}
+
+	uchar* Data = Entry.Data;
+	CacheLock.unlock();
+
+	const lcLibraryCacheEntryHeader* EntryHeader = reinterpret_cast<const lcLibraryCacheEntryHeader*>(Data);
+	lcMemFile MeshFile;
+
+	MeshFile.WriteBuffer(Data + EntryHeader->MeshOffset, EntryHeader->MeshSize);
+	MeshFile.Seek(0, SEEK_SET);
 
 	lcMesh* Mesh = new lcMesh;
-	if (Mesh->FileLoad(MeshData))
+
+	if (Mesh->FileLoad(MeshFile, Data + EntryHeader->VertexDataOffset, EntryHeader->VertexDataSize, Data + EntryHeader->IndexDataOffset, EntryHeader->IndexDataSize))
 	{
 		Info->SetMesh(Mesh);
 		return true;
@@ -1140,120 +1446,503 @@ bool lcPiecesLibrary::LoadCachePiece(PieceInfo* Info)
 
 bool lcPiecesLibrary::SaveCachePiece(PieceInfo* Info)
 {
-	lcMemFile MeshData;
+	lcMesh* Mesh = Info->GetMesh();
+	lcMemFile MeshFile;
 
-	const qint32 Flags = static_cast<qint32>(mStudStyle) + static_cast<qint32>(mStudCylinderColorEnabled);
-	if (MeshData.WriteBuffer((char*)&Flags, sizeof(Flags)) == 0)
+	if (!Mesh->FileSave(MeshFile))
 		return false;
 
-	if (!Info->GetMesh()->FileSave(MeshData))
+	QMutexLocker CacheLock(&mPieceCacheMutex);
+
+	if (!mPieceCacheFile.isOpen())
 		return false;
 
-	QString FileName = QFileInfo(QDir(mCachePath), QString::fromLatin1(Info->mFileName)).absoluteFilePath();
+	QLockFile FileLock(mPieceCacheFile.fileName() + QLatin1String(".lock"));
 
-	return WriteArchiveCacheFile(FileName, MeshData);
-}
+	if (!FileLock.tryLock(LC_LIBRARY_CACHE_LOCK_TIMEOUT))
+		return false;
 
-class lcSleeper : public QThread
-{
-public:
-	static void msleep(unsigned long Msecs)
-	{
-		QThread::msleep(Msecs);
-	}
-};
+	// Other instances append to the same pack, so the end of the file is only known while holding the lock.
+	// Stop writing if the pack was replaced since it was opened, entries added to the old file would be lost.
+	const qint64 Offset = mPieceCacheFile.size();
+
+	if (Offset < mPieceCacheSize || QFileInfo(mPieceCacheFile.fileName()).size() != Offset)
+		return false;
+
+	const qint32 Flags = static_cast<qint32>(mStudStyle) + static_cast<qint32>(mStudCylinderColorEnabled);
+	const QByteArray EntryData = lcCreateCacheEntry(Offset, Flags, Info->mFileName, (quint32)strlen(Info->mFileName), MeshFile.mBuffer, (quint32)MeshFile.GetLength(), Mesh->mVertexData, Mesh->mVertexDataSize, Mesh->mIndexData, Mesh->mIndexDataSize);
+
+	if (!mPieceCacheFile.seek(Offset) || mPieceCacheFile.write(EntryData) != EntryData.size())
+		return false;
+
+	mPieceCacheFile.flush();
+	mPieceCacheSize = Offset + EntryData.size();
+
+	lcLibraryCacheEntry& Entry = mPieceCacheEntries[Info->mFileName];
+
+	mPieceCacheDeadSize += Entry.Size;
+	Entry = { Offset, (quint32)EntryData.size(), Flags, nullptr };
+
+	return true;
+}
 
 void lcPiecesLibrary::LoadPieceInfo(PieceInfo* Info, bool Wait, bool Priority)
 {
 	QMutexLocker LoadLock(&mLoadMutex);
 
+	RemoveUnusedPiece(Info);
+
 	if (Wait)
 	{
-		if (Info->AddRef() == 1)
-			Info->Load();
-		else
+		const bool FirstReference = Info->AddRef() == 1;
+
+		if (Info->mState == lcPieceInfoState::Unloaded)
 		{
-			if (Info->mState == lcPieceInfoState::Unloaded)
-			{
-				Info->Load();
+			Info->Load();
+			NotifyPieceLoaded();
+
+			if (!FirstReference)
 				emit PartLoaded(Info);
-			}
-			else
-			{
-				LoadLock.unlock();
+		}
+		else if (Info->mState == lcPieceInfoState::Loading)
+		{
+			LoadLock.unlock();
 
-				while (Info->mState != lcPieceInfoState::Loaded)
-					lcSleeper::msleep(10);
-			}
+			QMutexLocker LoadedLock(&mPieceLoadedMutex);
+
+			while (Info->mState != lcPieceInfoState::Loaded)
+				mPieceLoadedCondition.wait(&mPieceLoadedMutex);
 		}
 	}
 	else
 	{
-		if (Info->AddRef() == 1)
+		if (Info->AddRef() == 1 && Info->mState == lcPieceInfoState::Unloaded)
 		{
-			if (Priority)
-				mLoadQueue.prepend(Info);
+			if (mLoadBatches.empty())
+				QueuePieceLoad(Info, Priority);
 			else
-				mLoadQueue.append(Info);
-
-			mLoadFutures.append(QtConcurrent::run([this]() { LoadQueuedPiece(); }));
+				mLoadBatches.back().push_back(Info);
 		}
 	}
 }
 
+void lcPiecesLibrary::BeginBatchLoad()
+{
+	QMutexLocker LoadLock(&mLoadMutex);
+
+	mLoadBatches.emplace_back();
+}
+
+void lcPiecesLibrary::EndBatchLoad()
+{
+	mLoadMutex.lock();
+
+	const std::vector<PieceInfo*> Pieces = std::move(mLoadBatches.back());
+	mLoadBatches.pop_back();
+
+	for (PieceInfo* Info : Pieces)
+	{
+		mBatchPieces.insert(Info);
+		QueuePieceLoad(Info, false);
+	}
+
+	mLoadMutex.unlock();
+
+	WaitForLoadQueue();
+
+	mLoadMutex.lock();
+
+	for (PieceInfo* Info : Pieces)
+		mBatchPieces.erase(Info);
+
+	mLoadMutex.unlock();
+
+	if (!Pieces.empty())
+		emit BatchLoaded();
+}
+
+void lcPiecesLibrary::NotifyPieceLoaded()
+{
+	QMutexLocker LoadedLock(&mPieceLoadedMutex);
+	mPieceLoadedCondition.wakeAll();
+}
+
 void lcPiecesLibrary::ReleasePieceInfo(PieceInfo* Info)
 {
 	QMutexLocker LoadLock(&mLoadMutex);
 
 	if (Info->GetRefCount() == 0 || Info->Release() == 0)
+	{
+		if (mMemoryStats.Budget && !Info->IsTemporary() && Info->mState == lcPieceInfoState::Loaded)
+			AddUnusedPiece(Info);
+		else
+			Info->Unload();
+
+		EnforceMemoryBudget();
+	}
+}
+
+void lcPiecesLibrary::AddUnusedPiece(PieceInfo* Info)
+{
+	RemoveUnusedPiece(Info);
+
+	Info->mUnusedStamp = mNextUnusedStamp++;
+	mUnusedPieces[Info->mUnusedStamp] = Info;
+}
+
+void lcPiecesLibrary::RemoveUnusedPiece(PieceInfo* Info)
+{
+	if (!Info->mUnusedStamp)
+		return;
+
+	mUnusedPieces.erase(Info->mUnusedStamp);
+	Info->mUnusedStamp = 0;
+}
+
+void lcPiecesLibrary::EnforceMemoryBudget()
+{
+	QMutexLocker LoadLock(&mLoadMutex);
+
+	const qint64 Budget = mMemoryStats.Budget;
+
+	if (!Budget)
+		return;
+
+	qint64 MemorySize = GetMemorySize();
+
+	while (MemorySize > Budget && !mUnusedPieces.empty())
+	{
+		PieceInfo* Info = mUnusedPieces.begin()->second;
+		RemoveUnusedPiece(Info);
+
+		if (Info->GetRefCount() || Info->mState != lcPieceInfoState::Loaded)
+			continue;
+
 		Info->Unload();
+		MemorySize = GetMemorySize();
+
+		QMutexLocker MemoryLock(&mMemoryMutex);
+		mMemoryStats.EvictedPieces++;
+	}
+
+	if (MemorySize <= Budget)
+		return;
+
+	if (mLoadsPending.loadAcquire() || !mLoadingLock.tryLockForWrite())
+		return;
+
+	QMutexLocker PrimitiveLock(&mPrimitiveMutex);
+	std::vector<lcLibraryPrimitive*> Primitives;
+
+	for (const std::unique_ptr<lcLibrarySource>& Source : mSources)
+		for (const auto& PrimitiveIt : Source->Primitives)
+			if (PrimitiveIt.second->mState == lcPrimitiveState::Loaded)
+				Primitives.push_back(PrimitiveIt.second);
+
+	auto PrimitiveCompare = [](lcLibraryPrimitive* Primitive1, lcLibraryPrimitive* Primitive2)
+	{
+		return Primitive1->mLastUsed.loadAcquire() < Primitive2->mLastUsed.loadAcquire();
+	};
+
+	std::sort(Primitives.begin(), Primitives.end(), PrimitiveCompare);
+
+	for (lcLibraryPrimitive* Primitive : Primitives)
+	{
+		if (MemorySize <= Budget)
+			break;
+
+		MemorySize -= Primitive->mMemorySize;
+		UnloadPrimitive(Primitive);
+
+		QMutexLocker MemoryLock(&mMemoryMutex);
+		mMemoryStats.EvictedPrimitives++;
+	}
+
+	mLoadingLock.unlock();
 }
 
-void lcPiecesLibrary::LoadQueuedPiece()
+qint64 lcPiecesLibrary::GetMemorySize()
 {
-	mLoadMutex.lock();
+	lcLibraryMemoryStats MemoryStats = GetMemoryStats();
 
-	PieceInfo* Info = nullptr;
+	return MemoryStats.VertexBytes + MemoryStats.IndexBytes + MemoryStats.PrimitiveBytes + MemoryStats.TextureBytes;
+}
+
+void lcPiecesLibrary::AddMesh(lcMesh* Mesh)
+{
+	mBufferMutex.lock();
+	mPendingBufferMeshes.insert(Mesh);
+	mBuffersDirty.storeRelease(1);
+	mBufferMutex.unlock();
+
+	mMeshStamp.fetchAndAddRelease(1);
+
+	QMutexLocker MemoryLock(&mMemoryMutex);
+
+	mMemoryStats.VertexBytes += Mesh->mVertexDataSize;
+	mMemoryStats.IndexBytes += Mesh->mIndexDataSize;
+}
+
+void lcPiecesLibrary::RemoveMesh(lcMesh* Mesh)
+{
+	mBufferMutex.lock();
+
+	mPendingBufferMeshes.erase(Mesh);
 
-	while (!mLoadQueue.isEmpty())
+	if (mBufferMeshes.erase(Mesh))
 	{
-		Info = mLoadQueue.takeFirst();
+		mVertexArena.Free(Mesh->mVertexCacheOffset, Mesh->mVertexBufferSize);
+		mIndexArena.Free(Mesh->mIndexCacheOffset, Mesh->mIndexDataSize);
+	}
+
+	mBufferMutex.unlock();
+
+	mMeshStamp.fetchAndAddRelease(1);
+
+	QMutexLocker MemoryLock(&mMemoryMutex);
+
+	mMemoryStats.VertexBytes -= Mesh->mVertexDataSize;
+	mMemoryStats.IndexBytes -= Mesh->mIndexDataSize;
+}
 
-		if (Info->mState == lcPieceInfoState::Unloaded && Info->GetRefCount() > 0)
+lcLibraryMemoryStats lcPiecesLibrary::GetMemoryStats()
+{
+	QMutexLocker LoadLock(&mLoadMutex);
+	qint64 TextureBytes = 0;
+
+	mTextureMutex.lock();
+
+	for (const lcTexture* Texture : mTextures)
+		if (Texture->mTexture || Texture->GetImageCount())
+			TextureBytes += static_cast<qint64>(Texture->mWidth) * Texture->mHeight * 4;
+
+	mTextureMutex.unlock();
+
+	QMutexLocker MemoryLock(&mMemoryMutex);
+
+	lcLibraryMemoryStats MemoryStats = mMemoryStats;
+	MemoryStats.TextureBytes = TextureBytes;
+	MemoryStats.UnusedPieces = static_cast<int>(mUnusedPieces.size());
+
+	return MemoryStats;
+}
+
+static bool lcTakeLoadToken(QAtomicInt& Tokens)
+{
+	int Value = Tokens.loadAcquire();
+
+	while (Value > 0)
+		if (Tokens.testAndSetOrdered(Value, Value - 1, Value))
+			return true;
+
+	return false;
+}
+
+void lcPiecesLibrary::QueuePieceLoad(PieceInfo* Info, bool Priority)
+{
+	if (Priority)
+	{
+		QMutexLocker PriorityLock(&mPriorityLoadQueue.Mutex);
+		mPriorityLoadQueue.Pieces.prepend(Info);
+	}
+	else
+	{
+		lcPieceLoadQueue& LoadQueue = *mLoadQueues[static_cast<quint32>(mNextLoadQueue.fetchAndAddRelaxed(1)) % mLoadQueues.size()];
+
+		QMutexLocker LoadQueueLock(&LoadQueue.Mutex);
+		LoadQueue.Pieces.append(Info);
+	}
+
+	if (mLoadsPending.fetchAndAddOrdered(1) == 0)
+	{
+		QMutexLocker StatsLock(&mLoadStatsMutex);
+		mLoadTimer.start();
+	}
+
+	const int QueueDepth = mLoadQueueDepth.fetchAndAddOrdered(1) + 1;
+	int PeakQueueDepth = mPeakLoadQueueDepth.loadAcquire();
+
+	while (QueueDepth > PeakQueueDepth && !mPeakLoadQueueDepth.testAndSetOrdered(PeakQueueDepth, QueueDepth, PeakQueueDepth))
+		continue;
+
+	// The queue mutex is only needed to wake a worker that's waiting for work.
+	if (mSleepingLoadThreads.loadAcquire())
+	{
+		QMutexLocker QueueLock(&mLoadQueueMutex);
+		mLoadQueueCondition.wakeOne();
+	}
+}
+
+PieceInfo* lcPiecesLibrary::TakeQueuedPiece(int ThreadIndex)
+{
+	{
+		QMutexLocker PriorityLock(&mPriorityLoadQueue.Mutex);
+
+		if (!mPriorityLoadQueue.Pieces.isEmpty())
+			return mPriorityLoadQueue.Pieces.takeFirst();
+	}
+
+	const int NumQueues = static_cast<int>(mLoadQueues.size());
+
+	for (int QueueIdx = 0; QueueIdx < NumQueues; QueueIdx++)
+	{
+		lcPieceLoadQueue& LoadQueue = *mLoadQueues[(ThreadIndex + QueueIdx) % NumQueues];
+		QMutexLocker LoadQueueLock(&LoadQueue.Mutex);
+
+		if (!LoadQueue.Pieces.isEmpty())
+			return QueueIdx == 0 ? LoadQueue.Pieces.takeFirst() : LoadQueue.Pieces.takeLast();
+	}
+
+	return nullptr;
+}
+
+void lcPiecesLibrary::FinishQueuedPiece()
+{
+	if (mLoadsPending.fetchAndAddOrdered(-1) != 1)
+		return;
+
+	{
+		QMutexLocker StatsLock(&mLoadStatsMutex);
+		mLoadStats.LoadTime += mLoadTimer.elapsed();
+	}
+
+	QMutexLocker QueueLock(&mLoadQueueMutex);
+	mLoadIdleCondition.wakeAll();
+}
+
+void lcPiecesLibrary::ClearLoadQueue()
+{
+	int RemovedPieces = 0;
+
+	mPriorityLoadQueue.Mutex.lock();
+	RemovedPieces += mPriorityLoadQueue.Pieces.size();
+	mPriorityLoadQueue.Pieces.clear();
+	mPriorityLoadQueue.Mutex.unlock();
+
+	for (std::unique_ptr<lcPieceLoadQueue>& LoadQueue : mLoadQueues)
+	{
+		QMutexLocker LoadQueueLock(&LoadQueue->Mutex);
+		RemovedPieces += LoadQueue->Pieces.size();
+		LoadQueue->Pieces.clear();
+	}
+
+	// A piece whose token was already taken is finished by the worker that took it.
+	for (int PieceIdx = 0; PieceIdx < RemovedPieces; PieceIdx++)
+		if (lcTakeLoadToken(mLoadQueueDepth))
+			FinishQueuedPiece();
+}
+
+void lcPiecesLibrary::ProcessLoadQueue(int ThreadIndex)
+{
+	for (;;)
+	{
+		if (!lcTakeLoadToken(mLoadQueueDepth))
 		{
-			Info->mState = lcPieceInfoState::Loading;
-			break;
+			QMutexLocker QueueLock(&mLoadQueueMutex);
+
+			mSleepingLoadThreads.fetchAndAddOrdered(1);
+
+			while (!mLoadQueueDepth.loadAcquire() && !mStopLoadThreads)
+				mLoadQueueCondition.wait(&mLoadQueueMutex);
+
+			mSleepingLoadThreads.fetchAndAddOrdered(-1);
+
+			if (mStopLoadThreads)
+				return;
+
+			continue;
 		}
 
-		Info = nullptr;
-	}
+		PieceInfo* Info = TakeQueuedPiece(ThreadIndex);
+		bool BatchPiece = false;
 
-	mLoadMutex.unlock();
+		if (Info)
+		{
+			mLoadMutex.lock();
 
-	if (Info)
-		Info->Load();
+			if (Info->mState == lcPieceInfoState::Unloaded && Info->GetRefCount() > 0)
+			{
+				Info->mState = lcPieceInfoState::Loading;
+				BatchPiece = mBatchPieces.find(Info) != mBatchPieces.end();
+			}
+			else
+				Info = nullptr;
+
+			mLoadMutex.unlock();
+		}
+
+		if (Info)
+		{
+			mLoadingLock.lockForRead();
+			Info->Load();
+			mLoadingLock.unlock();
+
+			NotifyPieceLoaded();
 
-	emit PartLoaded(Info);
+			if (!BatchPiece)
+				emit PartLoaded(Info);
+
+			QMutexLocker StatsLock(&mLoadStatsMutex);
+			mLoadStats.PiecesLoaded++;
+		}
+
+		FinishQueuedPiece();
+	}
 }
 
 void lcPiecesLibrary::WaitForLoadQueue()
 {
-	for (QFuture<void>& Future : mLoadFutures)
-		Future.waitForFinished();
-	mLoadFutures.clear();
+	QMutexLocker QueueLock(&mLoadQueueMutex);
+
+	while (mLoadsPending.loadAcquire())
+		mLoadIdleCondition.wait(&mLoadQueueMutex);
+}
+
+lcPieceLoadStats lcPiecesLibrary::GetLoadStats()
+{
+	QMutexLocker StatsLock(&mLoadStatsMutex);
+
+	lcPieceLoadStats LoadStats = mLoadStats;
+	LoadStats.QueueDepth = mLoadQueueDepth.loadAcquire();
+	LoadStats.PeakQueueDepth = mPeakLoadQueueDepth.loadAcquire();
+
+	if (mLoadsPending.loadAcquire())
+		LoadStats.LoadTime += mLoadTimer.elapsed();
+
+	return LoadStats;
+}
+
+void lcPiecesLibrary::AddMeshLoaderStats(const lcMeshLoaderStats& Stats)
+{
+	QMutexLocker StatsLock(&mLoadStatsMutex);
+
+	mLoadStats.MeshLoader.VertexCacheHits += Stats.VertexCacheHits;
+	mLoadStats.MeshLoader.VertexCacheMisses += Stats.VertexCacheMisses;
+	mLoadStats.MeshLoader.TranslationOnly += Stats.TranslationOnly;
+	mLoadStats.MeshLoader.OptimizedTriangles += Stats.OptimizedTriangles;
+	mLoadStats.MeshLoader.CacheMissesBefore += Stats.CacheMissesBefore;
+	mLoadStats.MeshLoader.CacheMissesAfter += Stats.CacheMissesAfter;
+	mLoadStats.MeshLoader.TexturedMeshes += Stats.TexturedMeshes;
+	mLoadStats.MeshLoader.TexturedVertexTime += Stats.TexturedVertexTime;
 }
 
 bool lcPiecesLibrary::LoadPieceData(PieceInfo* Info)
 {
+	mMemoryStamp.fetchAndAddRelaxed(1);
+
 	lcLibraryMeshData MeshData;
 	lcMeshLoader MeshLoader(MeshData, true, nullptr, false);
+	MeshLoader.SetInstanceStuds(mInstanceStuds);
+	MeshLoader.SetSimplifyLod(true);
+	MeshData.SetOptimizeVertexCache(true);
 
 	bool Loaded = false;
 	bool SaveCache = false;
 
 	if (Info->mZipFileType != lcZipFileType::Count && mZipFiles[static_cast<int>(Info->mZipFileType)])
 	{
-		if (LoadCachePiece(Info))
+		// The cache only stores flattened meshes.
+		if (!mInstanceStuds && mReadPieceCache && LoadCachePiece(Info))
 			return true;
 
 		lcMemFile PieceFile;
@@ -1261,7 +1950,7 @@ bool lcPiecesLibrary::LoadPieceData(PieceInfo* Info)
 		if (mZipFiles[static_cast<int>(Info->mZipFileType)]->ExtractFile(Info->mZipFileIndex, PieceFile))
 			Loaded = MeshLoader.LoadMesh(PieceFile, LC_MESHDATA_SHARED);
 
-		SaveCache = Loaded && (Info->mZipFileType == lcZipFileType::Official);
+		SaveCache = Loaded && !mInstanceStuds && mReadPieceCache && (Info->mZipFileType == lcZipFileType::Official);
 	}
 	else
 	{
@@ -1323,12 +2012,10 @@ void lcPiecesLibrary::GetPrimitiveFile(lcLibraryPrimitive* Primitive, std::funct
 
 void lcPiecesLibrary::GetPieceFile(const char* PieceName, std::function<void(lcFile& File)> Callback)
 {
-	const auto PieceIt = mPieces.find(PieceName);
+	PieceInfo* Info = mPieceIndex.Find(PieceName);
 
-	if (PieceIt != mPieces.end())
+	if (Info)
 	{
-		PieceInfo* Info = PieceIt->second;
-
 		if (mZipFiles[static_cast<int>(lcZipFileType::Official)] && Info->mZipFileType != lcZipFileType::Count)
 		{
 			lcMemFile IncludeFile;
@@ -1427,6 +2114,68 @@ void lcPiecesLibrary::GetPieceFile(const char* PieceName, std::function<void(lcF
 	}
 }
 
+void lcBufferArena::Reset(int Size)
+{
+	mFreeRanges.clear();
+	mSize = Size;
+	mUsedSize = 0;
+
+	if (Size)
+		mFreeRanges[0] = Size;
+}
+
+int lcBufferArena::Allocate(int Size)
+{
+	Size = GetAllocationSize(Size);
+
+	for (auto RangeIt = mFreeRanges.begin(); RangeIt != mFreeRanges.end(); RangeIt++)
+	{
+		if (RangeIt->second < Size)
+			continue;
+
+		const int Offset = RangeIt->first;
+		const int RangeSize = RangeIt->second;
+
+		mFreeRanges.erase(RangeIt);
+
+		if (RangeSize > Size)
+			mFreeRanges[Offset + Size] = RangeSize - Size;
+
+		mUsedSize += Size;
+
+		return Offset;
+	}
+
+	return -1;
+}
+
+void lcBufferArena::Free(int Offset, int Size)
+{
+	Size = GetAllocationSize(Size);
+	mUsedSize -= Size;
+
+	auto NextIt = mFreeRanges.lower_bound(Offset);
+
+	if (NextIt != mFreeRanges.end() && Offset + Size == NextIt->first)
+	{
+		Size += NextIt->second;
+		NextIt = mFreeRanges.erase(NextIt);
+	}
+
+	if (NextIt != mFreeRanges.begin())
+	{
+		auto PreviousIt = std::prev(NextIt);
+
+		if (PreviousIt->first + PreviousIt->second == Offset)
+		{
+			PreviousIt->second += Size;
+			return;
+		}
+	}
+
+	mFreeRanges[Offset] = Size;
+}
+
 void lcPiecesLibrary::ReleaseBuffers()
 {
 	lcContext* Context = lcContext::GetGlobalOffscreenContext();
@@ -1435,65 +2184,116 @@ void lcPiecesLibrary::ReleaseBuffers()
 	Context->DestroyVertexBuffer(mVertexBuffer);
 	Context->DestroyIndexBuffer(mIndexBuffer);
 
-	mBuffersDirty = true;
+	QMutexLocker BufferLock(&mBufferMutex);
+
+	for (lcMesh* Mesh : mBufferMeshes)
+	{
+		Mesh->mVertexCacheOffset = -1;
+		Mesh->mIndexCacheOffset = -1;
+		Mesh->mCompactVertices = false;
+		mPendingBufferMeshes.insert(Mesh);
+	}
+
+	mBufferMeshes.clear();
+	mVertexArena.Reset(0);
+	mIndexArena.Reset(0);
+
+	mBuffersDirty.storeRelease(1);
 }
 
-void lcPiecesLibrary::UpdateBuffers(lcContext* Context)
+bool lcPiecesLibrary::UseCompactVertices() const
 {
-	if (!gSupportsVertexBufferObject || !mBuffersDirty)
-		return;
-
-	int VertexDataSize = 0;
-	int IndexDataSize = 0;
-	std::vector<lcMesh*> Meshes;
+	// The compact layout relies on the shaders to read the quantized positions and the packed normals.
+	return mCompactVertices && gSupportsShaderObjects;
+}
 
-	for (const auto& PieceIt : mPieces)
-	{
-		const PieceInfo* const Info = PieceIt.second;
-		lcMesh* Mesh = Info->GetMesh();
+bool lcPiecesLibrary::AddBufferMesh(lcContext* Context, lcMesh* Mesh)
+{
+	const bool CompactVertices = UseCompactVertices();
+	const int VertexBufferSize = Mesh->GetVertexBufferSize(CompactVertices);
+	const int VertexOffset = mVertexArena.Allocate(VertexBufferSize);
 
-		if (!Mesh)
-			continue;
+	if (VertexOffset == -1)
+		return false;
 
-		if (Mesh->mVertexDataSize > 16 * 1024 * 1024 || Mesh->mIndexDataSize > 16 * 1024 * 1024)
-			continue;
+	const int IndexOffset = mIndexArena.Allocate(Mesh->mIndexDataSize);
 
-		VertexDataSize += Mesh->mVertexDataSize;
-		IndexDataSize += Mesh->mIndexDataSize;
+	if (IndexOffset == -1)
+	{
+		mVertexArena.Free(VertexOffset, VertexBufferSize);
+		return false;
+	}
 
-		Meshes.push_back(Mesh);
+	if (CompactVertices)
+	{
+		std::vector<char> VertexData(VertexBufferSize);
+		Mesh->WriteCompactVertexBuffer(VertexData.data());
+		Context->UpdateVertexBuffer(mVertexBuffer, VertexOffset, VertexBufferSize, VertexData.data());
 	}
+	else
+		Context->UpdateVertexBuffer(mVertexBuffer, VertexOffset, VertexBufferSize, Mesh->mVertexData);
 
-	Context->DestroyVertexBuffer(mVertexBuffer);
-	Context->DestroyIndexBuffer(mIndexBuffer);
+	Context->UpdateIndexBuffer(mIndexBuffer, IndexOffset, Mesh->mIndexDataSize, Mesh->mIndexData);
+
+	Mesh->mVertexBufferSize = VertexBufferSize;
+	Mesh->mCompactVertices = CompactVertices;
+	Mesh->mVertexCacheOffset = VertexOffset;
+	Mesh->mIndexCacheOffset = IndexOffset;
+	mBufferMeshes.insert(Mesh);
 
-	if (!VertexDataSize || !IndexDataSize)
+	return true;
+}
+
+void lcPiecesLibrary::UpdateBuffers(lcContext* Context)
+{
+	if (!gSupportsVertexBufferObject || !mBuffersDirty.loadAcquire())
 		return;
 
-	void* VertexData = malloc(VertexDataSize);
-	void* IndexData = malloc(IndexDataSize);
+	QMutexLocker BufferLock(&mBufferMutex);
 
-	VertexDataSize = 0;
-	IndexDataSize = 0;
+	std::vector<lcMesh*> PendingMeshes;
+	std::vector<lcMesh*> OverflowMeshes;
 
-	for (lcMesh* Mesh : Meshes)
-	{
-		Mesh->mVertexCacheOffset = VertexDataSize;
-		Mesh->mIndexCacheOffset = IndexDataSize;
+	for (lcMesh* Mesh : mPendingBufferMeshes)
+		if (Mesh->mVertexDataSize <= 16 * 1024 * 1024 && Mesh->mIndexDataSize <= 16 * 1024 * 1024)
+			PendingMeshes.push_back(Mesh);
+
+	mPendingBufferMeshes.clear();
+	mBuffersDirty.storeRelease(0);
+
+	for (lcMesh* Mesh : PendingMeshes)
+		if (!AddBufferMesh(Context, Mesh))
+			OverflowMeshes.push_back(Mesh);
 
-		memcpy((char*)VertexData + VertexDataSize, Mesh->mVertexData, Mesh->mVertexDataSize);
-		memcpy((char*)IndexData + IndexDataSize, Mesh->mIndexData, Mesh->mIndexDataSize);
+	if (OverflowMeshes.empty())
+		return;
+
+	// Out of space, move everything to larger buffers and leave some room for the next parts.
+	int VertexDataSize = mVertexArena.GetUsedSize();
+	int IndexDataSize = mIndexArena.GetUsedSize();
 
-		VertexDataSize += Mesh->mVertexDataSize;
-		IndexDataSize += Mesh->mIndexDataSize;
+	for (const lcMesh* Mesh : OverflowMeshes)
+	{
+		VertexDataSize += lcBufferArena::GetAllocationSize(Mesh->GetVertexBufferSize(UseCompactVertices()));
+		IndexDataSize += lcBufferArena::GetAllocationSize(Mesh->mIndexDataSize);
 	}
 
-	mVertexBuffer = Context->CreateVertexBuffer(VertexDataSize, VertexData);
-	mIndexBuffer = Context->CreateIndexBuffer(IndexDataSize, IndexData);
-	mBuffersDirty = false;
+	VertexDataSize = qMax(VertexDataSize + VertexDataSize / 2, mVertexArena.GetSize() * 2);
+	IndexDataSize = qMax(IndexDataSize + IndexDataSize / 2, mIndexArena.GetSize() * 2);
+
+	OverflowMeshes.insert(OverflowMeshes.end(), mBufferMeshes.begin(), mBufferMeshes.end());
+	mBufferMeshes.clear();
 
-	free(VertexData);
-	free(IndexData);
+	Context->DestroyVertexBuffer(mVertexBuffer);
+	Context->DestroyIndexBuffer(mIndexBuffer);
+
+	mVertexBuffer = Context->CreateVertexBuffer(VertexDataSize, nullptr);
+	mIndexBuffer = Context->CreateIndexBuffer(IndexDataSize, nullptr);
+	mVertexArena.Reset(VertexDataSize);
+	mIndexArena.Reset(IndexDataSize);
+
+	for (lcMesh* Mesh : OverflowMeshes)
+		AddBufferMesh(Context, Mesh);
 }
 
 void lcPiecesLibrary::UnloadUnusedParts()
@@ -1503,9 +2303,17 @@ void lcPiecesLibrary::UnloadUnusedParts()
 	for (const auto& PieceIt : mPieces)
 	{
 		PieceInfo* Info = PieceIt.second;
-		if (Info->GetRefCount() == 0 && Info->mState != lcPieceInfoState::Unloaded)
-			ReleasePieceInfo(Info);
+
+		if (Info->GetRefCount() || Info->mState == lcPieceInfoState::Unloaded || Info->mUnusedStamp)
+			continue;
+
+		if (mMemoryStats.Budget && !Info->IsTemporary() && Info->mState == lcPieceInfoState::Loaded)
+			AddUnusedPiece(Info);
+		else
+			Info->Unload();
 	}
+
+	EnforceMemoryBudget();
 }
 
 bool lcPiecesLibrary::LoadTexture(lcTexture* Texture)
@@ -1539,6 +2347,7 @@ void lcPiecesLibrary::ReleaseTexture(lcTexture* Texture)
 
 	if (Texture->Release() == 0 && Texture->IsTemporary())
 	{
+		QMutexLocker TextureLock(&mTextureMutex);
 		std::vector<lcTexture*>::iterator TextureIt = std::find(mTextures.begin(), mTextures.end(), Texture);
 		if (TextureIt != mTextures.end())
 			mTextures.erase(TextureIt);
@@ -1563,7 +2372,7 @@ void lcPiecesLibrary::SetStudStyle(lcStudStyle StudStyle, bool Reload, bool Stud
 	LoadColors();
 	UpdateStudStyleSource();
 
-	mLoadMutex.lock();
+	mPrimitiveMutex.lock();
 
 	for (const std::unique_ptr<lcLibrarySource>& Source : mSources)
 	{
@@ -1572,11 +2381,11 @@ void lcPiecesLibrary::SetStudStyle(lcStudStyle StudStyle, bool Reload, bool Stud
 			lcLibraryPrimitive* Primitive = PrimitiveIt.second;
 
 			if (Primitive->mStudStyle || Primitive->mMeshData.mHasStyleStud)
-				Primitive->Unload();
+				UnloadPrimitive(Primitive);
 		}
 	}
 
-	mLoadMutex.unlock();
+	mPrimitiveMutex.unlock();
 
 	if (Reload)
 	{
@@ -1588,9 +2397,11 @@ void lcPiecesLibrary::SetStudStyle(lcStudStyle StudStyle, bool Reload, bool Stud
 
 			if (Info->mState == lcPieceInfoState::Loaded && Info->GetMesh() && Info->GetMesh()->mFlags & lcMeshFlag::HasStyleStud)
 			{
+				RemoveUnusedPiece(Info);
 				Info->Unload();
-				mLoadQueue.append(Info);
-				mLoadFutures.append(QtConcurrent::run([this]() { LoadQueuedPiece(); }));
+
+				if (Info->GetRefCount())
+					QueuePieceLoad(Info, false);
 			}
 		}
 
@@ -1603,7 +2414,7 @@ void lcPiecesLibrary::SetStudStyle(lcStudStyle StudStyle, bool Reload, bool Stud
 bool lcPiecesLibrary::IsPrimitive(const char* Name) const
 {
 	for (const std::unique_ptr<lcLibrarySource>& Source : mSources)
-		if (Source->Primitives.find(Name) != Source->Primitives.end())
+		if (Source->PrimitiveIndex.Find(Name))
 			return true;
 
 	return false;
@@ -1613,33 +2424,86 @@ lcLibraryPrimitive* lcPiecesLibrary::FindPrimitive(const char* Name) const
 {
 	for (const std::unique_ptr<lcLibrarySource>& Source : mSources)
 	{
-		const auto PrimitiveIt = Source->Primitives.find(Name);
+		lcLibraryPrimitive* Primitive = Source->PrimitiveIndex.Find(Name);
 
-		if (PrimitiveIt != Source->Primitives.end())
-			return PrimitiveIt->second;
+		if (Primitive)
+			return Primitive;
 	}
 
-	return	nullptr;
+	return nullptr;
 }
 
 bool lcPiecesLibrary::LoadPrimitive(lcLibraryPrimitive* Primitive)
 {
-	mLoadMutex.lock();
+	QMutexLocker PrimitiveLock(&mPrimitiveMutex);
+
+	while (Primitive->mState == lcPrimitiveState::Loading)
+		mPrimitiveLoadedCondition.wait(&mPrimitiveMutex);
 
-	if (Primitive->mState == lcPrimitiveState::NotLoaded)
-		Primitive->mState = lcPrimitiveState::Loading;
+	if (Primitive->mState == lcPrimitiveState::Loaded)
+		return true;
+
+	Primitive->mState = lcPrimitiveState::Loading;
+	PrimitiveLock.unlock();
+
+	const bool Loaded = ReadPrimitiveData(Primitive);
+
+	PrimitiveLock.relock();
+
+	if (Loaded)
+	{
+		Primitive->mMeshData.ReleaseVertexHashes();
+		Primitive->mState = lcPrimitiveState::Loaded;
+		Primitive->mMemorySize = Primitive->mMeshData.GetMemorySize();
+
+		QMutexLocker MemoryLock(&mMemoryMutex);
+		mMemoryStats.PrimitiveBytes += Primitive->mMemorySize;
+	}
 	else
+		Primitive->Unload();
+
+	mPrimitiveLoadedCondition.wakeAll();
+
+	return Loaded;
+}
+
+std::shared_ptr<lcMesh> lcPiecesLibrary::GetPrimitiveMesh(lcLibraryPrimitive* Primitive)
+{
+	QMutexLocker PrimitiveLock(&mPrimitiveMutex);
+
+	if (Primitive->mMesh || Primitive->mState != lcPrimitiveState::Loaded)
+		return Primitive->mMesh;
+
+	// CreateMesh() resolves the material colors so it runs on a copy of the primitive data.
+	lcLibraryMeshData MeshData;
+	MeshData.SetOptimizeVertexCache(true);
+	MeshData.AddMeshDataNoDuplicateCheck(Primitive->mMeshData, lcMatrix44Identity(), 16, false, false, nullptr, LC_MESHDATA_SHARED);
+
+	const auto MeshDeleter = [this](lcMesh* Mesh)
 	{
-		mLoadMutex.unlock();
+		RemoveMesh(Mesh);
+		delete Mesh;
+	};
 
-		while (Primitive->mState == lcPrimitiveState::Loading)
-			lcSleeper::msleep(5);
+	Primitive->mMesh = std::shared_ptr<lcMesh>(MeshData.CreateMesh(), MeshDeleter);
+	Primitive->mMesh->mFlags |= lcMeshFlag::Primitive;
+	AddMesh(Primitive->mMesh.get());
 
-		return Primitive->mState == lcPrimitiveState::Loaded;
-	}
+	return Primitive->mMesh;
+}
 
-	mLoadMutex.unlock();
+void lcPiecesLibrary::UnloadPrimitive(lcLibraryPrimitive* Primitive)
+{
+	mMemoryMutex.lock();
+	mMemoryStats.PrimitiveBytes -= Primitive->mMemorySize;
+	mMemoryMutex.unlock();
+
+	mPrimitiveStamp.fetchAndAddRelease(1);
+	Primitive->Unload();
+}
 
+bool lcPiecesLibrary::ReadPrimitiveData(lcLibraryPrimitive* Primitive)
+{
 	lcMeshLoader MeshLoader(Primitive->mMeshData, true, nullptr, false);
 
 	if (mZipFiles[static_cast<int>(lcZipFileType::Official)])
@@ -1702,10 +2566,6 @@ bool lcPiecesLibrary::LoadPrimitive(lcLibraryPrimitive* Primitive)
 		}
 	}
 
-	mLoadMutex.lock();
-	Primitive->mState = lcPrimitiveState::Loaded;
-	mLoadMutex.unlock();
-
 	return true;
 }
 
@@ -1839,10 +2699,10 @@ std::vector<PieceInfo*> lcPiecesLibrary::GetPartsFromSet(const std::vector<std::
 
 	for (const std::string& PartId : PartIds)
 	{
-		std::map<std::string, PieceInfo*>::const_iterator PartIt = mPieces.find(PartId);
+		PieceInfo* Info = mPieceIndex.Find(PartId.c_str());
 
-		if (PartIt != mPieces.end())
-			Parts.push_back(PartIt->second);
+		if (Info)
+			Parts.push_back(Info);
 	}
 
 	return Parts;
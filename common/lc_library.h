@@ -4,6 +4,7 @@
 #include "lc_math.h"
 #include "lc_array.h"
 #include "lc_meshloader.h"
+#include "lc_nameindex.h"
 
 class PieceInfo;
 class lcZipFile;
@@ -64,6 +65,7 @@ public:
 		mStud = Stud;
 		mStudStyle = StudStyle;
 		mSubFile = SubFile;
+		mMemorySize = 0;
 	}
 
 	void SetZipFile(lcZipFileType ZipFileType, quint32 ZipFileIndex)
@@ -76,6 +78,8 @@ public:
 	{
 		mState = lcPrimitiveState::NotLoaded;
 		mMeshData.Clear();
+		mMesh.reset();
+		mMemorySize = 0;
 	}
 
 	QString mFileName;
@@ -87,6 +91,9 @@ public:
 	bool mStudStyle;
 	bool mSubFile;
 	lcLibraryMeshData mMeshData;
+	std::shared_ptr<lcMesh> mMesh;
+	size_t mMemorySize;
+	QAtomicInt mLastUsed;
 };
 
 enum class lcLibrarySourceType
@@ -110,8 +117,78 @@ struct lcLibrarySource
 	lcLibrarySource& operator=(const lcLibrarySource&) = delete;
 	lcLibrarySource& operator=(lcLibrarySource&&) = delete;
 
+	void AddPrimitive(const char* Name, lcLibraryPrimitive* Primitive)
+	{
+		Primitives[Name] = Primitive;
+		PrimitiveIndex.Insert(Name, Primitive);
+	}
+
 	lcLibrarySourceType Type;
 	std::map<std::string, lcLibraryPrimitive*> Primitives;
+	lcNameIndex<lcLibraryPrimitive> PrimitiveIndex;
+};
+
+struct lcLibraryCacheEntry
+{
+	qint64 Offset;
+	quint32 Size;
+	qint32 Flags;
+	uchar* Data;
+};
+
+struct lcPieceLoadQueue
+{
+	QMutex Mutex;
+	QList<PieceInfo*> Pieces;
+};
+
+struct lcPieceLoadStats
+{
+	int QueueDepth = 0;
+	int PeakQueueDepth = 0;
+	int PiecesLoaded = 0;
+	qint64 LoadTime = 0;
+	lcMeshLoaderStats MeshLoader;
+};
+
+struct lcLibraryMemoryStats
+{
+	qint64 VertexBytes = 0;
+	qint64 IndexBytes = 0;
+	qint64 PrimitiveBytes = 0;
+	qint64 TextureBytes = 0;
+	qint64 Budget = 0;
+	int UnusedPieces = 0;
+	int EvictedPieces = 0;
+	int EvictedPrimitives = 0;
+};
+
+class lcBufferArena
+{
+public:
+	void Reset(int Size);
+	int Allocate(int Size);
+	void Free(int Offset, int Size);
+
+	int GetSize() const
+	{
+		return mSize;
+	}
+
+	int GetUsedSize() const
+	{
+		return mUsedSize;
+	}
+
+	static int GetAllocationSize(int Size)
+	{
+		return qMax((Size + 15) & ~15, 16);
+	}
+
+protected:
+	std::map<int, int> mFreeRanges;
+	int mSize = 0;
+	int mUsedSize = 0;
 };
 
 class lcPiecesLibrary : public QObject
@@ -137,10 +214,33 @@ public:
 	PieceInfo* FindPiece(const char* PieceName, Project* Project, bool CreatePlaceholder, bool SearchProjectFolder);
 	void LoadPieceInfo(PieceInfo* Info, bool Wait, bool Priority);
 	void ReleasePieceInfo(PieceInfo* Info);
+	void BeginBatchLoad();
+	void EndBatchLoad();
 	bool LoadBuiltinPieces();
 	bool LoadPieceData(PieceInfo* Info);
-	void LoadQueuedPiece();
+	void ProcessLoadQueue(int ThreadIndex);
 	void WaitForLoadQueue();
+	lcPieceLoadStats GetLoadStats();
+	void AddMeshLoaderStats(const lcMeshLoaderStats& Stats);
+
+	void AddMesh(lcMesh* Mesh);
+	void RemoveMesh(lcMesh* Mesh);
+	lcLibraryMemoryStats GetMemoryStats();
+
+	int GetMemoryStamp() const
+	{
+		return mMemoryStamp.loadAcquire();
+	}
+
+	int GetMeshStamp() const
+	{
+		return mMeshStamp.loadAcquire();
+	}
+
+	int GetPrimitiveStamp() const
+	{
+		return mPrimitiveStamp.loadAcquire();
+	}
 
 	lcTexture* FindTexture(const char* TextureName, Project* CurrentProject, bool SearchProjectFolder);
 	bool LoadTexture(lcTexture* Texture);
@@ -161,6 +261,7 @@ public:
 	bool IsPrimitive(const char* Name) const;
 	lcLibraryPrimitive* FindPrimitive(const char* Name) const;
 	bool LoadPrimitive(lcLibraryPrimitive* Primitive);
+	std::shared_ptr<lcMesh> GetPrimitiveMesh(lcLibraryPrimitive* Primitive);
 
 	bool SupportsStudStyle() const;
 	void SetStudStyle(lcStudStyle StudStyle, bool Reload, bool StudCylinderColorEnabled);
@@ -181,22 +282,29 @@ public:
 		return mCancelLoading;
 	}
 
+	void SetReadPieceCache(bool ReadPieceCache)
+	{
+		mReadPieceCache = ReadPieceCache;
+	}
+
 	void UpdateBuffers(lcContext* Context);
 	void UnloadUnusedParts();
 
 	std::map<std::string, PieceInfo*> mPieces;
+	lcNameIndex<PieceInfo> mPieceIndex;
 	int mNumOfficialPieces;
 
 	std::vector<lcTexture*> mTextures;
 
 	QDir mLibraryDir;
 
-	bool mBuffersDirty;
+	QAtomicInt mBuffersDirty;
 	lcVertexBuffer mVertexBuffer;
 	lcIndexBuffer mIndexBuffer;
 
 signals:
 	void PartLoaded(PieceInfo* Info);
+	void BatchLoaded();
 	void ColorsLoaded();
 
 protected:
@@ -210,16 +318,36 @@ protected:
 	bool WriteArchiveCacheFile(const QString& FileName, lcMemFile& CacheFile);
 	bool LoadCacheIndex(const QString& FileName);
 	bool SaveArchiveCacheIndex(const QString& FileName);
+	bool OpenPieceCache();
+	bool LoadPieceCacheEntries();
+	bool CompactPieceCache();
+	void ClosePieceCache();
 	bool LoadCachePiece(PieceInfo* Info);
 	bool SaveCachePiece(PieceInfo* Info);
 	bool ReadDirectoryCacheFile(const QString& FileName, lcMemFile& CacheFile);
 	bool WriteDirectoryCacheFile(const QString& FileName, lcMemFile& CacheFile);
 
+	void AddPiece(const char* Name, PieceInfo* Info);
+	void QueuePieceLoad(PieceInfo* Info, bool Priority);
+	void NotifyPieceLoaded();
+	PieceInfo* TakeQueuedPiece(int ThreadIndex);
+	void FinishQueuedPiece();
+	void ClearLoadQueue();
+	bool ReadPrimitiveData(lcLibraryPrimitive* Primitive);
+	void UnloadPrimitive(lcLibraryPrimitive* Primitive);
+
+	void AddUnusedPiece(PieceInfo* Info);
+	void RemoveUnusedPiece(PieceInfo* Info);
+	void EnforceMemoryBudget();
+	qint64 GetMemorySize();
+
 	static bool IsStudPrimitive(const char* FileName);
 	static bool IsStudStylePrimitive(const char* FileName);
 	void UpdateStudStyleSource();
 
 	void ReleaseBuffers();
+	bool AddBufferMesh(lcContext* Context, lcMesh* Mesh);
+	bool UseCompactVertices() const;
 
 	std::vector<std::unique_ptr<lcLibrarySource>> mSources;
 
@@ -228,16 +356,61 @@ protected:
 #else
 	QMutex mLoadMutex;
 #endif
-	QList<QFuture<void>> mLoadFutures;
-	QList<PieceInfo*> mLoadQueue;
+	std::vector<std::unique_ptr<QThread>> mLoadThreads;
+	std::vector<std::unique_ptr<lcPieceLoadQueue>> mLoadQueues;
+	lcPieceLoadQueue mPriorityLoadQueue;
+	QMutex mLoadQueueMutex;
+	QWaitCondition mLoadQueueCondition;
+	QWaitCondition mLoadIdleCondition;
+	QAtomicInt mLoadQueueDepth;
+	QAtomicInt mPeakLoadQueueDepth;
+	QAtomicInt mLoadsPending;
+	QAtomicInt mNextLoadQueue;
+	QAtomicInt mSleepingLoadThreads;
+	bool mStopLoadThreads;
+	QReadWriteLock mLoadingLock;
+	QMutex mLoadStatsMutex;
+	lcPieceLoadStats mLoadStats;
+	QElapsedTimer mLoadTimer;
+
+	std::vector<std::vector<PieceInfo*>> mLoadBatches;
+	std::set<PieceInfo*> mBatchPieces;
+
+	QMutex mPieceLoadedMutex;
+	QWaitCondition mPieceLoadedCondition;
+
+	QMutex mPrimitiveMutex;
+	QWaitCondition mPrimitiveLoadedCondition;
+
+	QMutex mBufferMutex;
+	lcBufferArena mVertexArena;
+	lcBufferArena mIndexArena;
+	std::set<lcMesh*> mPendingBufferMeshes;
+	std::set<lcMesh*> mBufferMeshes;
+	QAtomicInt mMeshStamp;
+
+	QMutex mMemoryMutex;
+	lcLibraryMemoryStats mMemoryStats;
+	QAtomicInt mMemoryStamp;
+	QAtomicInt mPrimitiveStamp;
+	std::map<quint64, PieceInfo*> mUnusedPieces;
+	quint64 mNextUnusedStamp;
 
 	QMutex mTextureMutex;
 
 	lcStudStyle mStudStyle;
 	bool mStudCylinderColorEnabled;
+	bool mInstanceStuds;
+	bool mReadPieceCache;
+	bool mCompactVertices;
 
 	QString mCachePath;
 	qint64 mArchiveCheckSum[4];
+	QFile mPieceCacheFile;
+	qint64 mPieceCacheSize;
+	qint64 mPieceCacheDeadSize;
+	QMutex mPieceCacheMutex;
+	std::map<std::string, lcLibraryCacheEntry> mPieceCacheEntries;
 	std::unique_ptr<lcZipFile> mZipFiles[static_cast<int>(lcZipFileType::Count)];
 	bool mHasUnofficial;
 	bool mCancelLoading;
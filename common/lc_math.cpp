@@ -0,0 +1,65 @@
+#include "lc_global.h"
+#include "lc_math.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define LC_MATH_SSE2
+#include <emmintrin.h>
+#endif
+
+#ifdef LC_MATH_SSE2
+
+// The rows are added in the same order as lcMul31() so the results match the scalar code exactly.
+template<bool Translate>
+static void lcTransformVectorsSSE2(const lcMatrix44& Transform, const lcVector3* Input, size_t InputStride, lcVector3* Output, size_t OutputStride, size_t Count)
+{
+	const __m128 Row0 = _mm_loadu_ps(Transform.r[0]);
+	const __m128 Row1 = _mm_loadu_ps(Transform.r[1]);
+	const __m128 Row2 = _mm_loadu_ps(Transform.r[2]);
+	const __m128 Row3 = _mm_loadu_ps(Transform.r[3]);
+
+	const char* InputData = reinterpret_cast<const char*>(Input);
+	char* OutputData = reinterpret_cast<char*>(Output);
+
+	for (size_t VectorIdx = 0; VectorIdx < Count; VectorIdx++, InputData += InputStride, OutputData += OutputStride)
+	{
+		const float* Vector = reinterpret_cast<const float*>(InputData);
+		float* Result = reinterpret_cast<float*>(OutputData);
+
+		__m128 Sum = _mm_add_ps(_mm_mul_ps(Row0, _mm_set1_ps(Vector[0])), _mm_mul_ps(Row1, _mm_set1_ps(Vector[1])));
+		Sum = _mm_add_ps(Sum, _mm_mul_ps(Row2, _mm_set1_ps(Vector[2])));
+
+		if (Translate)
+			Sum = _mm_add_ps(Sum, Row3);
+
+		_mm_storel_pi(reinterpret_cast<__m64*>(Result), Sum);
+		_mm_store_ss(Result + 2, _mm_movehl_ps(Sum, Sum));
+	}
+}
+
+#endif
+
+void lcTransformPositions(const lcMatrix44& Transform, const lcVector3* Input, size_t InputStride, lcVector3* Output, size_t OutputStride, size_t Count)
+{
+#ifdef LC_MATH_SSE2
+	lcTransformVectorsSSE2<true>(Transform, Input, InputStride, Output, OutputStride, Count);
+#else
+	const char* InputData = reinterpret_cast<const char*>(Input);
+	char* OutputData = reinterpret_cast<char*>(Output);
+
+	for (size_t VectorIdx = 0; VectorIdx < Count; VectorIdx++, InputData += InputStride, OutputData += OutputStride)
+		*reinterpret_cast<lcVector3*>(OutputData) = lcMul31(*reinterpret_cast<const lcVector3*>(InputData), Transform);
+#endif
+}
+
+void lcTransformDirections(const lcMatrix44& Transform, const lcVector3* Input, size_t InputStride, lcVector3* Output, size_t OutputStride, size_t Count)
+{
+#ifdef LC_MATH_SSE2
+	lcTransformVectorsSSE2<false>(Transform, Input, InputStride, Output, OutputStride, Count);
+#else
+	const char* InputData = reinterpret_cast<const char*>(Input);
+	char* OutputData = reinterpret_cast<char*>(Output);
+
+	for (size_t VectorIdx = 0; VectorIdx < Count; VectorIdx++, InputData += InputStride, OutputData += OutputStride)
+		*reinterpret_cast<lcVector3*>(OutputData) = lcMul30(*reinterpret_cast<const lcVector3*>(InputData), Transform);
+#endif
+}
@@ -722,6 +722,11 @@ inline lcVector4 lcMul4(const lcVector4& a, const lcMatrix44& b)
 	return b.r[0] * a[0] + b.r[1] * a[1] + b.r[2] * a[2] + b.r[3] * a[3];
 }
 
+// Batch versions of lcMul31() and lcMul30() with the same results. Strides are in bytes so the vectors
+// can be members of larger vertex structures, the output can alias the input.
+void lcTransformPositions(const lcMatrix44& Transform, const lcVector3* Input, size_t InputStride, lcVector3* Output, size_t OutputStride, size_t Count);
+void lcTransformDirections(const lcMatrix44& Transform, const lcVector3* Input, size_t InputStride, lcVector3* Output, size_t OutputStride, size_t Count);
+
 inline lcMatrix33 lcMul(const lcMatrix33& a, const lcMatrix33& b)
 {
 	const lcVector3 Col0(b.r[0][0], b.r[1][0], b.r[2][0]);
@@ -7,8 +7,9 @@
 #include "lc_application.h"
 #include "lc_library.h"
 
-#define LC_MESH_FILE_ID      LC_FOURCC('M', 'E', 'S', 'H')
-#define LC_MESH_FILE_VERSION 0x0121
+#define LC_MESH_CLUSTER_TRIANGLES 256
+#define LC_MESH_CLUSTER_MIN_TRIANGLES 1024
+#define LC_MESH_LOD_LOWER_SIZE 0.05f
 
 lcMesh* gPlaceholderMesh;
 
@@ -22,6 +23,7 @@ lcMesh::lcMesh()
 
 	mNumVertices = 0;
 	mNumTexturedVertices = 0;
+	mConditionalVertexCount = 0;
 	mIndexType = 0;
 	mVertexData = nullptr;
 	mVertexDataSize = 0;
@@ -29,17 +31,33 @@ lcMesh::lcMesh()
 	mIndexDataSize = 0;
 	mVertexCacheOffset = -1;
 	mIndexCacheOffset = -1;
+	mVertexBufferSize = 0;
+	mCompactVertices = false;
+	mDequantizeMatrix = lcMatrix44Identity();
+	mMappedData = false;
 }
 
 lcMesh::~lcMesh()
 {
-	free(mVertexData);
-	free(mIndexData);
+	if (!mMappedData)
+	{
+		free(mVertexData);
+		free(mIndexData);
+	}
+
 	for (int LodIdx = 0; LodIdx < LC_NUM_MESH_LODS; LodIdx++)
 		delete[] mLods[LodIdx].Sections;
 }
 
 void lcMesh::Create(quint16(&NumSections)[LC_NUM_MESH_LODS], int VertexCount, int TexturedVertexCount, int ConditionalVertexCount, int IndexCount)
+{
+	CreateSections(NumSections, VertexCount, TexturedVertexCount, ConditionalVertexCount, IndexCount);
+
+	mVertexData = malloc(mVertexDataSize);
+	mIndexData = malloc(mIndexDataSize);
+}
+
+void lcMesh::CreateSections(quint16(&NumSections)[LC_NUM_MESH_LODS], int VertexCount, int TexturedVertexCount, int ConditionalVertexCount, int IndexCount)
 {
 	for (int LodIdx = 0; LodIdx < LC_NUM_MESH_LODS; LodIdx++)
 	{
@@ -52,7 +70,6 @@ void lcMesh::Create(quint16(&NumSections)[LC_NUM_MESH_LODS], int VertexCount, in
 	mNumTexturedVertices = TexturedVertexCount;
 	mConditionalVertexCount = ConditionalVertexCount;
 	mVertexDataSize = VertexCount * sizeof(lcVertex) + TexturedVertexCount * sizeof(lcVertexTextured) + ConditionalVertexCount * sizeof(lcVertexConditional);
-	mVertexData = malloc(mVertexDataSize);
 
 	if (VertexCount < 0x10000 && TexturedVertexCount < 0x10000 && ConditionalVertexCount < 0x10000)
 	{
@@ -64,8 +81,6 @@ void lcMesh::Create(quint16(&NumSections)[LC_NUM_MESH_LODS], int VertexCount, in
 		mIndexType = GL_UNSIGNED_INT;
 		mIndexDataSize = IndexCount * sizeof(GLuint);
 	}
-
-	mIndexData = malloc(mIndexDataSize);
 }
 
 void lcMesh::CreateBox()
@@ -225,10 +240,26 @@ bool lcMesh::MinIntersectDist(const lcVector3& Start, const lcVector3& End, floa
 
 bool lcMesh::MinIntersectDist(const lcVector3& Start, const lcVector3& End, float& MinDist, lcVector3& HitPlane)
 {
+	bool Hit;
+
 	if (mIndexType == GL_UNSIGNED_SHORT)
-		return MinIntersectDist<GLushort>(Start, End, MinDist, HitPlane);
+		Hit = MinIntersectDist<GLushort>(Start, End, MinDist, HitPlane);
 	else
-		return MinIntersectDist<GLuint>(Start, End, MinDist, HitPlane);
+		Hit = MinIntersectDist<GLuint>(Start, End, MinDist, HitPlane);
+
+	for (const lcMeshInstance& Instance : mInstances)
+	{
+		const lcMatrix44 InverseTransform = lcMatrix44AffineInverse(Instance.Transform);
+		lcVector3 InstanceHitPlane;
+
+		if (Instance.Mesh->MinIntersectDist(lcMul31(Start, InverseTransform), lcMul31(End, InverseTransform), MinDist, InstanceHitPlane))
+		{
+			HitPlane = lcMul30(InstanceHitPlane, Instance.Transform);
+			Hit = true;
+		}
+	}
+
+	return Hit;
 }
 
 template<typename IndexType>
@@ -256,9 +287,29 @@ bool lcMesh::IntersectsPlanes(const lcVector4 (&Planes)[6])
 bool lcMesh::IntersectsPlanes(const lcVector4 (&Planes)[6])
 {
 	if (mIndexType == GL_UNSIGNED_SHORT)
-		return IntersectsPlanes<GLushort>(Planes);
-	else
-		return IntersectsPlanes<GLuint>(Planes);
+	{
+		if (IntersectsPlanes<GLushort>(Planes))
+			return true;
+	}
+	else if (IntersectsPlanes<GLuint>(Planes))
+		return true;
+
+	for (const lcMeshInstance& Instance : mInstances)
+	{
+		const lcMatrix44 InverseTransform = lcMatrix44AffineInverse(Instance.Transform);
+		lcVector4 InstancePlanes[6];
+
+		for (int PlaneIdx = 0; PlaneIdx < 6; PlaneIdx++)
+		{
+			const lcVector3 PlaneNormal = lcMul30(Planes[PlaneIdx], InverseTransform);
+			InstancePlanes[PlaneIdx] = lcVector4(PlaneNormal, Planes[PlaneIdx][3] - lcDot3(InverseTransform[3], PlaneNormal));
+		}
+
+		if (Instance.Mesh->IntersectsPlanes(InstancePlanes))
+			return true;
+	}
+
+	return false;
 }
 
 template<typename IndexType>
@@ -374,7 +425,7 @@ void lcMesh::ExportWavefrontIndices(lcFile& File, int DefaultColorIndex, int Ver
 		ExportWavefrontIndices<GLuint>(File, DefaultColorIndex, VertexOffset);
 }
 
-bool lcMesh::FileLoad(lcMemFile& File)
+bool lcMesh::FileLoad(lcMemFile& File, void* VertexData, int VertexDataSize, void* IndexData, int IndexDataSize)
 {
 	if (File.ReadU32() != LC_MESH_FILE_ID || File.ReadU32() != LC_MESH_FILE_VERSION)
 		return false;
@@ -393,7 +444,14 @@ bool lcMesh::FileLoad(lcMemFile& File)
 	if (!File.ReadU16(&NumLods, 1) || NumLods != LC_NUM_MESH_LODS || !File.ReadU16(NumSections, LC_NUM_MESH_LODS))
 		return false;
 
-	Create(NumSections, VertexCount, TexturedVertexCount, ConditionalVertexCount, IndexCount);
+	CreateSections(NumSections, VertexCount, TexturedVertexCount, ConditionalVertexCount, IndexCount);
+
+	if (VertexDataSize != mVertexDataSize || IndexDataSize != mIndexDataSize)
+		return false;
+
+	mVertexData = VertexData;
+	mIndexData = IndexData;
+	mMappedData = true;
 
 	for (int LodIdx = 0; LodIdx < LC_NUM_MESH_LODS; LodIdx++)
 	{
@@ -401,7 +459,7 @@ bool lcMesh::FileLoad(lcMemFile& File)
 		{
 			lcMeshSection& Section = mLods[LodIdx].Sections[SectionIdx];
 
-			quint32 ColorCode, IndexOffset;
+			quint32 ColorCode, IndexOffset, FirstCluster, NumClusters;
 			quint16 PrimtiveType, Length;
 
 			if (!File.ReadU32(&ColorCode, 1) || !File.ReadU32(&IndexOffset, 1) || !File.ReadU32(&IndexCount, 1) || !File.ReadU16(&PrimtiveType, 1))
@@ -415,6 +473,12 @@ bool lcMesh::FileLoad(lcMemFile& File)
 			Section.BoundingBox.Max = File.ReadVector3();
 			Section.Radius = File.ReadFloat();
 
+			if (!File.ReadU32(&FirstCluster, 1) || !File.ReadU32(&NumClusters, 1))
+				return false;
+
+			Section.FirstCluster = FirstCluster;
+			Section.NumClusters = NumClusters;
+
 			if (!File.ReadU16(&Length, 1))
 				return false;
 
@@ -438,12 +502,25 @@ bool lcMesh::FileLoad(lcMemFile& File)
 		}
 	}
 
-	File.ReadBuffer(mVertexData, mNumVertices * sizeof(lcVertex) + mNumTexturedVertices * sizeof(lcVertexTextured) + mConditionalVertexCount * sizeof(lcVertexConditional));
+	quint32 ClusterCount;
 
-	if (mIndexType == GL_UNSIGNED_SHORT)
-		File.ReadU16((quint16*)mIndexData, mIndexDataSize / 2);
-	else
-		File.ReadU32((quint32*)mIndexData, mIndexDataSize / 4);
+	if (!File.ReadU32(&ClusterCount, 1))
+		return false;
+
+	mClusters.resize(ClusterCount);
+
+	for (lcMeshCluster& Cluster : mClusters)
+	{
+		quint32 IndexOffset;
+
+		if (!File.ReadU32(&IndexOffset, 1) || !File.ReadU32(&IndexCount, 1))
+			return false;
+
+		Cluster.IndexOffset = IndexOffset;
+		Cluster.NumIndices = IndexCount;
+		Cluster.Center = File.ReadVector3();
+		Cluster.Radius = File.ReadFloat();
+	}
 
 	return true;
 }
@@ -480,6 +557,8 @@ bool lcMesh::FileSave(lcMemFile& File)
 			File.WriteVector3(Section.BoundingBox.Min);
 			File.WriteVector3(Section.BoundingBox.Max);
 			File.WriteFloat(Section.Radius);
+			File.WriteU32(Section.FirstCluster);
+			File.WriteU32(Section.NumClusters);
 
 			if (Section.Texture)
 			{
@@ -492,23 +571,194 @@ bool lcMesh::FileSave(lcMemFile& File)
 		}
 	}
 
-	File.WriteBuffer(mVertexData, mNumVertices * sizeof(lcVertex) + mNumTexturedVertices * sizeof(lcVertexTextured) + mConditionalVertexCount * sizeof(lcVertexConditional));
+	File.WriteU32(static_cast<quint32>(mClusters.size()));
 
-	if (mIndexType == GL_UNSIGNED_SHORT)
-		File.WriteU16((quint16*)mIndexData, mIndexDataSize / 2);
-	else
-		File.WriteU32((quint32*)mIndexData, mIndexDataSize / 4);
+	for (const lcMeshCluster& Cluster : mClusters)
+	{
+		File.WriteU32(Cluster.IndexOffset);
+		File.WriteU32(Cluster.NumIndices);
+		File.WriteVector3(Cluster.Center);
+		File.WriteFloat(Cluster.Radius);
+	}
 
 	return true;
 }
 
-int lcMesh::GetLodIndex(float Distance) const
+// ProjectedSize is the radius of the mesh on screen as a fraction of half the viewport height.
+int lcMesh::GetLodIndex(float Distance, float ProjectedSize) const
 {
 	if (lcGetPiecesLibrary()->GetStudStyle() != lcStudStyle::Plain) // todo: support low lod studs
 		return LC_MESH_LOD_HIGH;
 
-	if (mLods[LC_MESH_LOD_LOW].NumSections && (Distance > mRadius))
-		return LC_MESH_LOD_LOW;
-	else
+	if (!mLods[LC_MESH_LOD_LOW].NumSections || Distance <= mRadius)
 		return LC_MESH_LOD_HIGH;
+
+	// The simplified levels are only generated for parts that could be reduced, stop at the last one available.
+	int LodIndex = LC_MESH_LOD_LOW;
+	float MaxProjectedSize = LC_MESH_LOD_LOWER_SIZE;
+
+	for (int LodIdx = LC_MESH_LOD_LOWER; LodIdx < LC_NUM_MESH_LODS; LodIdx++)
+	{
+		if (ProjectedSize >= MaxProjectedSize || !mLods[LodIdx].NumSections)
+			break;
+
+		LodIndex = LodIdx;
+		MaxProjectedSize *= 0.25f;
+	}
+
+	return LodIndex;
+}
+
+template<typename IndexType>
+void lcMesh::CreateClusters()
+{
+	mClusters.clear();
+
+	for (int LodIdx = 0; LodIdx < LC_NUM_MESH_LODS; LodIdx++)
+	{
+		for (int SectionIdx = 0; SectionIdx < mLods[LodIdx].NumSections; SectionIdx++)
+		{
+			lcMeshSection& Section = mLods[LodIdx].Sections[SectionIdx];
+
+			Section.FirstCluster = static_cast<int>(mClusters.size());
+			Section.NumClusters = 0;
+
+			if (Section.PrimitiveType != LC_MESH_TRIANGLES && Section.PrimitiveType != LC_MESH_TEXTURED_TRIANGLES)
+				continue;
+
+			if (Section.NumIndices < LC_MESH_CLUSTER_MIN_TRIANGLES * 3)
+				continue;
+
+			const IndexType* Indices = reinterpret_cast<const IndexType*>(static_cast<char*>(mIndexData) + Section.IndexOffset);
+			const bool Textured = Section.PrimitiveType == LC_MESH_TEXTURED_TRIANGLES;
+
+			// Triangles are already ordered for the vertex cache, so consecutive runs are spatially coherent.
+			for (int FirstIndex = 0; FirstIndex < Section.NumIndices; FirstIndex += LC_MESH_CLUSTER_TRIANGLES * 3)
+			{
+				const int NumIndices = qMin(LC_MESH_CLUSTER_TRIANGLES * 3, Section.NumIndices - FirstIndex);
+				lcVector3 Min(FLT_MAX, FLT_MAX, FLT_MAX), Max(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+
+				for (int Idx = FirstIndex; Idx < FirstIndex + NumIndices; Idx++)
+				{
+					const lcVector3& Position = Textured ? GetTexturedVertexData()[Indices[Idx]].Position : GetVertexData()[Indices[Idx]].Position;
+
+					Min = lcMin(Min, Position);
+					Max = lcMax(Max, Position);
+				}
+
+				lcMeshCluster Cluster;
+
+				Cluster.IndexOffset = Section.IndexOffset + FirstIndex * sizeof(IndexType);
+				Cluster.NumIndices = NumIndices;
+				Cluster.Center = (Min + Max) * 0.5f;
+				Cluster.Radius = lcLength(Max - Min) * 0.5f;
+
+				mClusters.push_back(Cluster);
+			}
+
+			Section.NumClusters = static_cast<int>(mClusters.size()) - Section.FirstCluster;
+		}
+	}
+}
+
+void lcMesh::CreateClusters()
+{
+	if (mIndexType == GL_UNSIGNED_SHORT)
+		CreateClusters<GLushort>();
+	else
+		CreateClusters<GLuint>();
+}
+
+int lcMesh::GetVertexBufferSize(bool Compact) const
+{
+	if (!Compact)
+		return mVertexDataSize;
+
+	return mNumVertices * sizeof(lcVertexCompact) + mNumTexturedVertices * sizeof(lcVertexTexturedCompact) + mConditionalVertexCount * sizeof(lcVertexConditionalCompact);
+}
+
+void lcMesh::WriteCompactVertexBuffer(void* Buffer)
+{
+	const lcVertex* Vertices = GetVertexData();
+	const lcVertexTextured* TexturedVertices = GetTexturedVertexData();
+	const lcVertexConditional* ConditionalVertices = GetConditionalVertexData();
+	lcVector3 Min(FLT_MAX, FLT_MAX, FLT_MAX), Max(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+
+	const auto AddPosition = [&Min, &Max](const lcVector3& Position)
+	{
+		Min = lcMin(Min, Position);
+		Max = lcMax(Max, Position);
+	};
+
+	for (int VertexIdx = 0; VertexIdx < mNumVertices; VertexIdx++)
+		AddPosition(Vertices[VertexIdx].Position);
+
+	for (int VertexIdx = 0; VertexIdx < mNumTexturedVertices; VertexIdx++)
+		AddPosition(TexturedVertices[VertexIdx].Position);
+
+	// Conditional lines are quantized with the rest of the mesh since their control points can be outside the bounding box.
+	for (int VertexIdx = 0; VertexIdx < mConditionalVertexCount; VertexIdx++)
+	{
+		const lcVertexConditional& Vertex = ConditionalVertices[VertexIdx];
+
+		AddPosition(Vertex.Position1);
+		AddPosition(Vertex.Position2);
+		AddPosition(Vertex.Position3);
+		AddPosition(Vertex.Position4);
+	}
+
+	lcVector3 Center(0.0f, 0.0f, 0.0f);
+	float Scale = 1.0f;
+
+	if (Min.x <= Max.x)
+	{
+		const lcVector3 Extents = (Max - Min) * 0.5f;
+		const float MaxExtent = qMax(qMax(Extents.x, Extents.y), Extents.z);
+
+		Center = (Min + Max) * 0.5f;
+
+		// A single scale for all axes keeps the normals transformed by the world matrix pointing the right way.
+		if (MaxExtent > 0.0f)
+			Scale = MaxExtent / 32767.0f;
+	}
+
+	mDequantizeMatrix = lcMul(lcMatrix44Scale(lcVector3(Scale, Scale, Scale)), lcMatrix44Translation(Center));
+
+	const auto Quantize = [&Center, Scale](const lcVector3& Position, qint16 (&Quantized)[4])
+	{
+		for (int AxisIdx = 0; AxisIdx < 3; AxisIdx++)
+			Quantized[AxisIdx] = static_cast<qint16>(qBound(-32767, qRound((Position[AxisIdx] - Center[AxisIdx]) / Scale), 32767));
+
+		Quantized[3] = 0;
+	};
+
+	lcVertexCompact* DstVertices = static_cast<lcVertexCompact*>(Buffer);
+
+	for (int VertexIdx = 0; VertexIdx < mNumVertices; VertexIdx++)
+	{
+		Quantize(Vertices[VertexIdx].Position, DstVertices[VertexIdx].Position);
+		DstVertices[VertexIdx].Normal = Vertices[VertexIdx].Normal;
+	}
+
+	lcVertexTexturedCompact* DstTexturedVertices = reinterpret_cast<lcVertexTexturedCompact*>(DstVertices + mNumVertices);
+
+	for (int VertexIdx = 0; VertexIdx < mNumTexturedVertices; VertexIdx++)
+	{
+		Quantize(TexturedVertices[VertexIdx].Position, DstTexturedVertices[VertexIdx].Position);
+		DstTexturedVertices[VertexIdx].Normal = TexturedVertices[VertexIdx].Normal;
+		DstTexturedVertices[VertexIdx].TexCoord = TexturedVertices[VertexIdx].TexCoord;
+	}
+
+	lcVertexConditionalCompact* DstConditionalVertices = reinterpret_cast<lcVertexConditionalCompact*>(DstTexturedVertices + mNumTexturedVertices);
+
+	for (int VertexIdx = 0; VertexIdx < mConditionalVertexCount; VertexIdx++)
+	{
+		const lcVertexConditional& Vertex = ConditionalVertices[VertexIdx];
+		lcVertexConditionalCompact& DstVertex = DstConditionalVertices[VertexIdx];
+
+		Quantize(Vertex.Position1, DstVertex.Position[0]);
+		Quantize(Vertex.Position2, DstVertex.Position[1]);
+		Quantize(Vertex.Position3, DstVertex.Position[2]);
+		Quantize(Vertex.Position4, DstVertex.Position[3]);
+	}
 }
@@ -2,6 +2,9 @@
 
 #include "lc_math.h"
 
+#define LC_MESH_FILE_ID      LC_FOURCC('M', 'E', 'S', 'H')
+#define LC_MESH_FILE_VERSION 0x0125
+
 enum lcMeshPrimitiveType
 {
 	LC_MESH_LINES = 0x01,
@@ -32,6 +35,35 @@ struct lcVertexConditional
 	lcVector3 Position4;
 };
 
+// Layouts used for the GPU copy of a mesh when compact vertices are enabled.
+// Positions are quantized to 16 bits against the mesh bounds and restored by the world matrix.
+struct lcVertexCompact
+{
+	qint16 Position[4];
+	quint32 Normal;
+};
+
+struct lcVertexTexturedCompact
+{
+	qint16 Position[4];
+	quint32 Normal;
+	lcVector2 TexCoord;
+};
+
+struct lcVertexConditionalCompact
+{
+	qint16 Position[4][4];
+};
+
+// Contiguous run of triangles in a large section, culled separately when drawing.
+struct lcMeshCluster
+{
+	int IndexOffset;
+	int NumIndices;
+	lcVector3 Center;
+	float Radius;
+};
+
 struct lcMeshSection
 {
 	int ColorIndex;
@@ -41,6 +73,8 @@ struct lcMeshSection
 	lcTexture* Texture;
 	lcBoundingBox BoundingBox;
 	float Radius;
+	int FirstCluster = 0;
+	int NumClusters = 0;
 };
 
 struct lcMeshLod
@@ -53,6 +87,8 @@ enum
 {
 	LC_MESH_LOD_HIGH,
 	LC_MESH_LOD_LOW,
+	LC_MESH_LOD_LOWER,
+	LC_MESH_LOD_LOWEST,
 	LC_NUM_MESH_LODS
 };
 
@@ -63,12 +99,19 @@ enum class lcMeshFlag
 	HasTranslucent = 0x04, // Mesh has triangles using a translucent color
 	HasLines       = 0x08, // Mesh has lines
 	HasTexture     = 0x10, // Mesh has sections using textures
-	HasStyleStud   = 0x20  // Mesh has a stud that can have a logo applied
+	HasStyleStud   = 0x20, // Mesh has a stud that can have a logo applied
+	Primitive      = 0x40  // Mesh is a primitive drawn as an instance of other meshes
 };
 
 Q_DECLARE_FLAGS(lcMeshFlags, lcMeshFlag)
 Q_DECLARE_OPERATORS_FOR_FLAGS(lcMeshFlags)
 
+struct lcMeshInstance
+{
+	std::shared_ptr<lcMesh> Mesh;
+	lcMatrix44 Transform;
+};
+
 class lcMesh
 {
 public:
@@ -83,7 +126,7 @@ public:
 	void Create(quint16 (&NumSections)[LC_NUM_MESH_LODS], int VertexCount, int TexturedVertexCount, int ConditionalVertexCount, int IndexCount);
 	void CreateBox();
 
-	bool FileLoad(lcMemFile& File);
+	bool FileLoad(lcMemFile& File, void* VertexData, int VertexDataSize, void* IndexData, int IndexDataSize);
 	bool FileSave(lcMemFile& File);
 
 	template<typename IndexType>
@@ -102,7 +145,27 @@ public:
 	bool IntersectsPlanes(const lcVector4 (&Planes)[6]);
 	bool IntersectsPlanes(const lcVector4 (&Planes)[6]);
 
-	int GetLodIndex(float Distance) const;
+	int GetLodIndex(float Distance, float ProjectedSize) const;
+
+	template<typename IndexType>
+	void CreateClusters();
+	void CreateClusters();
+
+	int GetVertexBufferSize(bool Compact) const;
+	void WriteCompactVertexBuffer(void* Buffer);
+
+	int GetTexturedVertexBufferOffset() const
+	{
+		return mNumVertices * (mCompactVertices ? sizeof(lcVertexCompact) : sizeof(lcVertex));
+	}
+
+	int GetConditionalVertexBufferOffset() const
+	{
+		if (mCompactVertices)
+			return mNumVertices * sizeof(lcVertexCompact) + mNumTexturedVertices * sizeof(lcVertexTexturedCompact);
+		else
+			return mNumVertices * sizeof(lcVertex) + mNumTexturedVertices * sizeof(lcVertexTextured);
+	}
 
 	const lcVertex* GetVertexData() const
 	{
@@ -120,6 +183,8 @@ public:
 	}
 
 	lcMeshLod mLods[LC_NUM_MESH_LODS];
+	std::vector<lcMeshInstance> mInstances;
+	std::vector<lcMeshCluster> mClusters;
 	lcBoundingBox mBoundingBox;
 	float mRadius;
 	lcMeshFlags mFlags;
@@ -130,11 +195,19 @@ public:
 	int mIndexDataSize;
 	int mVertexCacheOffset;
 	int mIndexCacheOffset;
+	int mVertexBufferSize;
+	bool mCompactVertices;
+	lcMatrix44 mDequantizeMatrix;
 
 	int mNumVertices;
 	int mNumTexturedVertices;
 	int mConditionalVertexCount;
 	int mIndexType;
+
+protected:
+	void CreateSections(quint16 (&NumSections)[LC_NUM_MESH_LODS], int VertexCount, int TexturedVertexCount, int ConditionalVertexCount, int IndexCount);
+
+	bool mMappedData;
 };
 
 
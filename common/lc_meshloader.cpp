@@ -5,6 +5,13 @@
 #include "lc_library.h"
 #include "lc_application.h"
 #include "lc_texture.h"
+#include "lc_meshsimplifier.h"
+#include "lc_meshoptimizer.h"
+#include <unordered_map>
+
+#define LC_MESH_SIMPLIFY_MIN_TRIANGLES 64
+#define LC_MESH_SIMPLIFY_TRIANGLE_RATIO 0.5f
+#define LC_MESH_SIMPLIFY_ERROR_RATIO 0.01f
 
 static void lcCheckTexCoordsWrap(const lcVector4& Plane2, const lcVector3 (&Positions)[3], lcVector2 (&TexCoords)[3])
 {
@@ -153,6 +160,50 @@ static bool lcCompareVertices(const lcVector3& Position1, const lcVector3& Posit
 	return fabsf(Position1.x - Position2.x) < lcDistanceEpsilon && fabsf(Position1.y - Position2.y) < lcDistanceEpsilon && fabsf(Position1.z - Position2.z) < lcDistanceEpsilon;
 }
 
+constexpr float lcVertexHashCellSize = 2.0f * lcDistanceEpsilon; // Vertices closer than the epsilon are never more than one cell apart
+
+static int lcGetVertexHashCell(float Coordinate)
+{
+	return static_cast<int>(qBound(-1.0e9f, floorf(Coordinate * (1.0f / lcVertexHashCellSize)), 1.0e9f));
+}
+
+static quint32 lcGetVertexHash(int x, int y, int z)
+{
+	return (static_cast<quint32>(x) * 73856093u) ^ (static_cast<quint32>(y) * 19349663u) ^ (static_cast<quint32>(z) * 83492791u);
+}
+
+// Copies the vertices of a primitive with the rotation and scale of a transform applied, without the translation.
+static void lcTransformVertices(const lcMeshLoaderTypeData& Data, const lcMatrix44& Transform, bool InvertNormals, std::vector<lcMeshLoaderVertex>& Vertices)
+{
+	Vertices.assign(Data.mVertices.begin(), Data.mVertices.end());
+
+	if (Vertices.empty())
+		return;
+
+	bool TranslationOnly = true;
+
+	for (int Row = 0; Row < 3; Row++)
+		for (int Column = 0; Column < 3; Column++)
+			if (Transform.r[Row][Column] != (Row == Column ? 1.0f : 0.0f))
+				TranslationOnly = false;
+
+	if (!TranslationOnly)
+	{
+		const lcMatrix33 NormalTransform = lcMatrix33Transpose(lcMatrix33(lcMatrix44Inverse(Transform)));
+
+		lcTransformDirections(Transform, &Vertices[0].Position, sizeof(lcMeshLoaderVertex), &Vertices[0].Position, sizeof(lcMeshLoaderVertex), Vertices.size());
+		lcTransformDirections(lcMatrix44(NormalTransform, lcVector3(0.0f, 0.0f, 0.0f)), &Vertices[0].Normal, sizeof(lcMeshLoaderVertex), &Vertices[0].Normal, sizeof(lcMeshLoaderVertex), Vertices.size());
+	}
+
+	for (lcMeshLoaderVertex& Vertex : Vertices)
+	{
+		Vertex.Normal = lcNormalize(Vertex.Normal);
+
+		if (InvertNormals)
+			Vertex.Normal = -Vertex.Normal;
+	}
+}
+
 lcMeshLoaderSection* lcMeshLoaderTypeData::AddSection(lcMeshPrimitiveType PrimitiveType, lcMeshLoaderMaterial* Material)
 {
 	for (const std::unique_ptr<lcMeshLoaderSection>& Section : mSections)
@@ -164,19 +215,88 @@ lcMeshLoaderSection* lcMeshLoaderTypeData::AddSection(lcMeshPrimitiveType Primit
 	return mSections.back().get();
 }
 
-quint32 lcMeshLoaderTypeData::AddVertex(const lcVector3& Position, bool Optimize)
+void lcMeshLoaderTypeData::UpdateVertexHash()
 {
-	if (Optimize)
+	const int VertexCount = mVertices.GetSize();
+	int HashedCount = static_cast<int>(mVertexHashNext.size());
+
+	if (HashedCount == VertexCount)
+		return;
+
+	if (HashedCount > VertexCount || VertexCount > static_cast<int>(mVertexHashBuckets.size()))
+	{
+		size_t BucketCount = qMax(mVertexHashBuckets.size(), static_cast<size_t>(1024));
+
+		while (BucketCount < static_cast<size_t>(VertexCount))
+			BucketCount *= 2;
+
+		mVertexHashBuckets.assign(BucketCount, -1);
+		HashedCount = 0;
+	}
+
+	mVertexHashNext.resize(VertexCount);
+	const quint32 Mask = static_cast<quint32>(mVertexHashBuckets.size() - 1);
+
+	for (int VertexIdx = HashedCount; VertexIdx < VertexCount; VertexIdx++)
+	{
+		const lcVector3& Position = mVertices[VertexIdx].Position;
+		const quint32 Bucket = lcGetVertexHash(lcGetVertexHashCell(Position.x), lcGetVertexHashCell(Position.y), lcGetVertexHashCell(Position.z)) & Mask;
+
+		mVertexHashNext[VertexIdx] = mVertexHashBuckets[Bucket];
+		mVertexHashBuckets[Bucket] = VertexIdx;
+	}
+}
+
+int lcMeshLoaderTypeData::FindVertex(const lcVector3& Position, const lcVector3* Normal)
+{
+	if (mVertices.IsEmpty())
+		return -1;
+
+	UpdateVertexHash();
+
+	const quint32 Mask = static_cast<quint32>(mVertexHashBuckets.size() - 1);
+	const int CellX = lcGetVertexHashCell(Position.x);
+	const int CellY = lcGetVertexHashCell(Position.y);
+	const int CellZ = lcGetVertexHashCell(Position.z);
+	int BestIndex = -1;
+
+	// Bucket chains are sorted from newest to oldest so the search returns the same vertex as a backwards linear scan.
+	for (int z = CellZ - 1; z <= CellZ + 1; z++)
 	{
-		for (int VertexIdx = mVertices.GetSize() - 1; VertexIdx >= 0; VertexIdx--)
+		for (int y = CellY - 1; y <= CellY + 1; y++)
 		{
-			const lcMeshLoaderVertex& Vertex = mVertices[VertexIdx];
+			for (int x = CellX - 1; x <= CellX + 1; x++)
+			{
+				for (int VertexIdx = mVertexHashBuckets[lcGetVertexHash(x, y, z) & Mask]; VertexIdx > BestIndex; VertexIdx = mVertexHashNext[VertexIdx])
+				{
+					const lcMeshLoaderVertex& Vertex = mVertices[VertexIdx];
+
+					if (!lcCompareVertices(Position, Vertex.Position))
+						continue;
 
-			if (lcCompareVertices(Position, Vertex.Position))
-				return VertexIdx;
+					if (Normal && Vertex.NormalWeight != 0.0f && !(lcDot(*Normal, Vertex.Normal) > 0.71f))
+						continue;
+
+					BestIndex = VertexIdx;
+					break;
+				}
+			}
 		}
 	}
 
+	return BestIndex;
+}
+
+quint32 lcMeshLoaderTypeData::AddVertex(const lcVector3& Position, bool Optimize)
+{
+	if (Optimize)
+	{
+		const int VertexIdx = FindVertex(Position, nullptr);
+
+		if (VertexIdx != -1)
+			return VertexIdx;
+	}
+
 	lcMeshLoaderVertex& Vertex = mVertices.Add();
 
 	Vertex.Position = Position;
@@ -190,25 +310,24 @@ quint32 lcMeshLoaderTypeData::AddVertex(const lcVector3& Position, const lcVecto
 {
 	if (Optimize)
 	{
-		for (int VertexIdx = mVertices.GetSize() - 1; VertexIdx >= 0; VertexIdx--)
+		const int VertexIdx = FindVertex(Position, &Normal);
+
+		if (VertexIdx != -1)
 		{
 			lcMeshLoaderVertex& Vertex = mVertices[VertexIdx];
 
-			if (lcCompareVertices(Position, Vertex.Position))
+			if (Vertex.NormalWeight == 0.0f)
 			{
-				if (Vertex.NormalWeight == 0.0f)
-				{
-					Vertex.Normal = Normal;
-					Vertex.NormalWeight = NormalWeight;
-					return VertexIdx;
-				}
-				else if (lcDot(Normal, Vertex.Normal) > 0.71f)
-				{
-					Vertex.Normal = lcNormalize(Vertex.Normal * Vertex.NormalWeight + Normal * NormalWeight);
-					Vertex.NormalWeight += NormalWeight;
-					return VertexIdx;
-				}
+				Vertex.Normal = Normal;
+				Vertex.NormalWeight = NormalWeight;
+			}
+			else
+			{
+				Vertex.Normal = lcNormalize(Vertex.Normal * Vertex.NormalWeight + Normal * NormalWeight);
+				Vertex.NormalWeight += NormalWeight;
 			}
+
+			return VertexIdx;
 		}
 	}
 
@@ -321,26 +440,30 @@ void lcMeshLoaderTypeData::AddMeshData(const lcMeshLoaderTypeData& Data, const l
 {
 	const lcArray<lcMeshLoaderVertex>& DataVertices = Data.mVertices;
 	lcArray<quint32> IndexRemap(DataVertices.GetSize());
-	const lcMatrix33 NormalTransform = lcMatrix33Transpose(lcMatrix33(lcMatrix44Inverse(Transform)));
+	const lcVector3 Translation(Transform.r[3]);
 
 	mVertices.AllocGrow(DataVertices.GetSize());
 
-	for (const lcMeshLoaderVertex& DataVertex : DataVertices)
+	if (!DataVertices.IsEmpty())
 	{
-		const lcVector3 Position = lcMul31(DataVertex.Position, Transform);
-		int Index;
+		lcMeshLoader* MeshLoader = mMeshData->GetMeshLoader();
+		std::vector<lcMeshLoaderVertex> Vertices;
 
-		if (DataVertex.NormalWeight == 0.0f)
-			Index = AddVertex(Position, true);
-		else
+		if (!MeshLoader)
+			lcTransformVertices(Data, Transform, InvertNormals, Vertices);
+
+		for (const lcMeshLoaderVertex& TransformedVertex : MeshLoader ? MeshLoader->GetTransformedVertices(Data, Transform, InvertNormals) : Vertices)
 		{
-			lcVector3 Normal = lcNormalize(lcMul(DataVertex.Normal, NormalTransform));
-			if (InvertNormals)
-				Normal = -Normal;
-			Index = AddVertex(Position, Normal, DataVertex.NormalWeight, true);
-		}
+			const lcVector3 Position = TransformedVertex.Position + Translation;
+			int Index;
 
-		IndexRemap.Add(Index);
+			if (TransformedVertex.NormalWeight == 0.0f)
+				Index = AddVertex(Position, true);
+			else
+				Index = AddVertex(Position, TransformedVertex.Normal, TransformedVertex.NormalWeight, true);
+
+			IndexRemap.Add(Index);
+		}
 	}
 
 	mConditionalVertices.AllocGrow(Data.mConditionalVertices.GetSize());
@@ -349,11 +472,7 @@ void lcMeshLoaderTypeData::AddMeshData(const lcMeshLoaderTypeData& Data, const l
 	for (const lcMeshLoaderConditionalVertex& DataVertex : Data.mConditionalVertices)
 	{
 		lcVector3 Position[4];
-		
-		Position[0] = lcMul31(DataVertex.Position[0], Transform);
-		Position[1] = lcMul31(DataVertex.Position[1], Transform);
-		Position[2] = lcMul31(DataVertex.Position[2], Transform);
-		Position[3] = lcMul31(DataVertex.Position[3], Transform);
+		lcTransformPositions(Transform, DataVertex.Position, sizeof(lcVector3), Position, sizeof(lcVector3), 4);
 
 		const int Index = AddConditionalVertex(Position);
 		ConditionalRemap.Add(Index);
@@ -413,35 +532,37 @@ void lcMeshLoaderTypeData::AddMeshDataNoDuplicateCheck(const lcMeshLoaderTypeDat
 {
 	const lcArray<lcMeshLoaderVertex>& DataVertices = Data.mVertices;
 	quint32 BaseIndex;
-	const lcMatrix33 NormalTransform = lcMatrix33Transpose(lcMatrix33(lcMatrix44Inverse(Transform)));
+	const lcVector3 Translation(Transform.r[3]);
 
 	BaseIndex = mVertices.GetSize();
 
 	mVertices.SetGrow(lcMin(mVertices.GetSize(), 8 * 1024 * 1024));
 	mVertices.AllocGrow(DataVertices.GetSize());
 
-	for (int SrcVertexIdx = 0; SrcVertexIdx < DataVertices.GetSize(); SrcVertexIdx++)
+	if (!DataVertices.IsEmpty())
 	{
-		const lcMeshLoaderVertex& SrcVertex = DataVertices[SrcVertexIdx];
-		lcMeshLoaderVertex& DstVertex = mVertices.Add();
-		DstVertex.Position = lcMul31(SrcVertex.Position, Transform);
-		DstVertex.Normal = lcNormalize(lcMul(SrcVertex.Normal, NormalTransform));
-		if (InvertNormals)
-			DstVertex.Normal = -DstVertex.Normal;
-		DstVertex.NormalWeight = SrcVertex.NormalWeight;
+		lcMeshLoader* MeshLoader = mMeshData->GetMeshLoader();
+		std::vector<lcMeshLoaderVertex> Vertices;
+
+		if (!MeshLoader)
+			lcTransformVertices(Data, Transform, InvertNormals, Vertices);
+
+		for (const lcMeshLoaderVertex& TransformedVertex : MeshLoader ? MeshLoader->GetTransformedVertices(Data, Transform, InvertNormals) : Vertices)
+		{
+			lcMeshLoaderVertex& DstVertex = mVertices.Add();
+			DstVertex.Position = TransformedVertex.Position + Translation;
+			DstVertex.Normal = TransformedVertex.Normal;
+			DstVertex.NormalWeight = TransformedVertex.NormalWeight;
+		}
 	}
 
-	mConditionalVertices.AllocGrow(Data.mConditionalVertices.GetSize());
 	const quint32 BaseConditional = mConditionalVertices.GetSize();
+	const int ConditionalVertexCount = Data.mConditionalVertices.GetSize();
 
-	for (const lcMeshLoaderConditionalVertex& DataVertex : Data.mConditionalVertices)
+	if (ConditionalVertexCount)
 	{
-		lcMeshLoaderConditionalVertex& Vertex = mConditionalVertices.Add();
-
-		Vertex.Position[0] = lcMul31(DataVertex.Position[0], Transform);
-		Vertex.Position[1] = lcMul31(DataVertex.Position[1], Transform);
-		Vertex.Position[2] = lcMul31(DataVertex.Position[2], Transform);
-		Vertex.Position[3] = lcMul31(DataVertex.Position[3], Transform);
+		mConditionalVertices.SetSize(BaseConditional + ConditionalVertexCount);
+		lcTransformPositions(Transform, Data.mConditionalVertices[0].Position, sizeof(lcVector3), mConditionalVertices[BaseConditional].Position, sizeof(lcVector3), ConditionalVertexCount * 4);
 	}
 
 	for (const std::unique_ptr<lcMeshLoaderSection>& SrcSection : Data.mSections)
@@ -629,14 +750,57 @@ static bool lcMeshLoaderFinalSectionCompare(const lcMeshLoaderFinalSection& a, c
 	return a.Color > b.Color;
 }
 
+static quint32 lcGetTexturedVertexHash(const lcVector3& Position, const lcVector3& Normal, const lcVector2& TexCoords)
+{
+	// Vertices are only merged when they are exactly equal so the hash uses the raw bits, adding zero folds -0.0 into 0.0.
+	const float Values[8] = { Position.x + 0.0f, Position.y + 0.0f, Position.z + 0.0f, Normal.x + 0.0f, Normal.y + 0.0f, Normal.z + 0.0f, TexCoords.x + 0.0f, TexCoords.y + 0.0f };
+	quint32 Hash = 2166136261u;
+
+	for (const float Value : Values)
+	{
+		quint32 Bits;
+		memcpy(&Bits, &Value, sizeof(Bits));
+		Hash = (Hash ^ Bits) * 16777619u;
+	}
+
+	return Hash ^ (Hash >> 16);
+}
+
 quint32 lcLibraryMeshData::AddTexturedVertex(const lcVector3& Position, const lcVector3& Normal, const lcVector2& TexCoords)
 {
-	for (int VertexIndex = mTexturedVertices.GetSize() - 1; VertexIndex >= 0; VertexIndex--)
+	const int VertexCount = mTexturedVertices.GetSize();
+
+	if (static_cast<int>(mTexturedVertexHashNext.size()) != VertexCount || VertexCount >= static_cast<int>(mTexturedVertexHashBuckets.size()))
+	{
+		size_t BucketCount = qMax(mTexturedVertexHashBuckets.size(), static_cast<size_t>(1024));
+
+		while (BucketCount <= static_cast<size_t>(VertexCount))
+			BucketCount *= 2;
+
+		mTexturedVertexHashBuckets.assign(BucketCount, -1);
+		mTexturedVertexHashNext.resize(VertexCount);
+
+		const quint32 Mask = static_cast<quint32>(BucketCount - 1);
+
+		for (int VertexIdx = 0; VertexIdx < VertexCount; VertexIdx++)
+		{
+			const lcMeshLoaderTexturedVertex& Vertex = mTexturedVertices[VertexIdx];
+			const quint32 Bucket = lcGetTexturedVertexHash(Vertex.Position, Vertex.Normal, Vertex.TexCoords) & Mask;
+
+			mTexturedVertexHashNext[VertexIdx] = mTexturedVertexHashBuckets[Bucket];
+			mTexturedVertexHashBuckets[Bucket] = VertexIdx;
+		}
+	}
+
+	const quint32 Bucket = lcGetTexturedVertexHash(Position, Normal, TexCoords) & static_cast<quint32>(mTexturedVertexHashBuckets.size() - 1);
+
+	// Chains run from the newest vertex to the oldest, the same order as the backwards scan this replaced.
+	for (int VertexIdx = mTexturedVertexHashBuckets[Bucket]; VertexIdx != -1; VertexIdx = mTexturedVertexHashNext[VertexIdx])
 	{
-		const lcMeshLoaderTexturedVertex& Vertex = mTexturedVertices[VertexIndex];
+		const lcMeshLoaderTexturedVertex& Vertex = mTexturedVertices[VertexIdx];
 
 		if (Vertex.Position == Position && Vertex.Normal == Normal && Vertex.TexCoords == TexCoords)
-			return VertexIndex;
+			return VertexIdx;
 	}
 
 	lcMeshLoaderTexturedVertex& Vertex = mTexturedVertices.Add();
@@ -645,7 +809,10 @@ quint32 lcLibraryMeshData::AddTexturedVertex(const lcVector3& Position, const lc
 	Vertex.Normal = Normal;
 	Vertex.TexCoords = TexCoords;
 
-	return mTexturedVertices.GetSize() - 1;
+	mTexturedVertexHashNext.push_back(mTexturedVertexHashBuckets[Bucket]);
+	mTexturedVertexHashBuckets[Bucket] = VertexCount;
+
+	return VertexCount;
 }
 
 void lcLibraryMeshData::GeneratePlanarTexcoords(lcMeshLoaderSection* Section, const lcMeshLoaderTypeData& Data)
@@ -793,6 +960,145 @@ void lcLibraryMeshData::GenerateTexturedVertices()
 	}
 }
 
+void lcLibraryMeshData::SimplifySharedSections(lcMeshLoaderLodIndices& LodIndices) const
+{
+	const lcMeshLoaderTypeData& Data = mData[LC_MESHDATA_SHARED];
+	const lcArray<lcMeshLoaderVertex>& Vertices = Data.mVertices;
+
+	if (Vertices.IsEmpty())
+		return;
+
+	std::vector<lcVector3> Positions;
+	Positions.reserve(Vertices.GetSize());
+
+	lcVector3 Min(FLT_MAX, FLT_MAX, FLT_MAX), Max(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+
+	for (const lcMeshLoaderVertex& Vertex : Vertices)
+	{
+		Positions.push_back(Vertex.Position);
+		Min = lcMin(Min, Vertex.Position);
+		Max = lcMax(Max, Vertex.Position);
+	}
+
+	// Vertices shared by sections of different colors can't move or the sections would pull apart.
+	std::vector<const lcMeshLoaderSection*> VertexSections(Vertices.GetSize(), nullptr);
+	lcMeshSimplifier Simplifier(std::move(Positions));
+
+	for (const std::unique_ptr<lcMeshLoaderSection>& Section : Data.mSections)
+	{
+		if (Section->mPrimitiveType != LC_MESH_TRIANGLES || Section->mMaterial->Type != lcMeshLoaderMaterialType::Solid)
+			continue;
+
+		for (const quint32 Index : Section->mIndices)
+		{
+			if (!VertexSections[Index])
+				VertexSections[Index] = Section.get();
+			else if (VertexSections[Index] != Section.get())
+				Simplifier.LockVertex(Index);
+		}
+	}
+
+	// Edge lines are drawn over the surface so the creases they follow can't move either.
+	std::unordered_map<quint32, std::vector<lcVector3>> LinePositions;
+
+	auto AddLinePosition = [&LinePositions](const lcVector3& Position)
+	{
+		LinePositions[lcGetVertexHash(lcGetVertexHashCell(Position.x), lcGetVertexHashCell(Position.y), lcGetVertexHashCell(Position.z))].push_back(Position);
+	};
+
+	for (int MeshDataIdx = LC_MESHDATA_LOW; MeshDataIdx <= LC_MESHDATA_SHARED; MeshDataIdx++)
+	{
+		const lcMeshLoaderTypeData& LineData = mData[MeshDataIdx];
+
+		for (const std::unique_ptr<lcMeshLoaderSection>& Section : LineData.mSections)
+			if (Section->mPrimitiveType == LC_MESH_LINES)
+				for (const quint32 Index : Section->mIndices)
+					AddLinePosition(LineData.mVertices[Index].Position);
+
+		for (const lcMeshLoaderConditionalVertex& ConditionalVertex : LineData.mConditionalVertices)
+		{
+			AddLinePosition(ConditionalVertex.Position[0]);
+			AddLinePosition(ConditionalVertex.Position[1]);
+		}
+	}
+
+	if (!LinePositions.empty())
+	{
+		for (int VertexIdx = 0; VertexIdx < Vertices.GetSize(); VertexIdx++)
+		{
+			const lcVector3& Position = Vertices[VertexIdx].Position;
+			const int CellX = lcGetVertexHashCell(Position.x);
+			const int CellY = lcGetVertexHashCell(Position.y);
+			const int CellZ = lcGetVertexHashCell(Position.z);
+			bool Locked = false;
+
+			for (int x = CellX - 1; x <= CellX + 1 && !Locked; x++)
+			{
+				for (int y = CellY - 1; y <= CellY + 1 && !Locked; y++)
+				{
+					for (int z = CellZ - 1; z <= CellZ + 1 && !Locked; z++)
+					{
+						const auto CellIt = LinePositions.find(lcGetVertexHash(x, y, z));
+
+						if (CellIt == LinePositions.end())
+							continue;
+
+						for (const lcVector3& LinePosition : CellIt->second)
+						{
+							if (lcCompareVertices(Position, LinePosition))
+							{
+								Simplifier.LockVertex(VertexIdx);
+								Locked = true;
+								break;
+							}
+						}
+					}
+				}
+			}
+		}
+	}
+
+	const float MaxDistance = lcLength(Max - Min) * 0.5f * LC_MESH_SIMPLIFY_ERROR_RATIO;
+
+	// Each level starts from the previous one and allows twice the distance error.
+	for (const std::unique_ptr<lcMeshLoaderSection>& Section : Data.mSections)
+	{
+		if (Section->mPrimitiveType != LC_MESH_TRIANGLES || Section->mMaterial->Type != lcMeshLoaderMaterialType::Solid)
+			continue;
+
+		double MaxError = static_cast<double>(MaxDistance) * MaxDistance;
+
+		for (int LodIdx = LC_MESH_LOD_LOW; LodIdx < LC_NUM_MESH_LODS; LodIdx++, MaxError *= 4.0)
+		{
+			const std::pair<const quint32*, int> SrcIndices = GetSharedSectionIndices(Section.get(), LodIdx - 1, LodIndices);
+			const size_t TriangleCount = SrcIndices.second / 3;
+
+			if (TriangleCount < LC_MESH_SIMPLIFY_MIN_TRIANGLES)
+				break;
+
+			std::vector<quint32> Indices = Simplifier.Simplify(SrcIndices.first, SrcIndices.second, static_cast<size_t>(TriangleCount * LC_MESH_SIMPLIFY_TRIANGLE_RATIO), MaxError);
+
+			if (Indices.size() >= static_cast<size_t>(SrcIndices.second))
+				break;
+
+			LodIndices[LodIdx][Section.get()] = std::move(Indices);
+		}
+	}
+}
+
+std::pair<const quint32*, int> lcLibraryMeshData::GetSharedSectionIndices(const lcMeshLoaderSection* Section, int LodIndex, const lcMeshLoaderLodIndices& LodIndices)
+{
+	for (int LodIdx = LodIndex; LodIdx >= LC_MESH_LOD_LOW; LodIdx--)
+	{
+		const auto LodIt = LodIndices[LodIdx].find(Section);
+
+		if (LodIt != LodIndices[LodIdx].end())
+			return std::make_pair(LodIt->second.data(), static_cast<int>(LodIt->second.size()));
+	}
+
+	return std::make_pair(Section->mIndices.begin(), Section->mIndices.GetSize());
+}
+
 lcMesh* lcLibraryMeshData::CreateMesh()
 {
 	lcMesh* Mesh = new lcMesh();
@@ -814,8 +1120,26 @@ lcMesh* lcLibraryMeshData::CreateMesh()
 	}
 
 	if (mHasTextures)
+	{
+		QElapsedTimer TexturedVertexTimer;
+		TexturedVertexTimer.start();
+
 		GenerateTexturedVertices();
 
+		if (mMeshLoader)
+		{
+			lcMeshLoaderStats& Stats = mMeshLoader->GetStats();
+
+			Stats.TexturedMeshes++;
+			Stats.TexturedVertexTime += TexturedVertexTimer.nsecsElapsed();
+		}
+	}
+
+	lcMeshLoaderLodIndices LodIndices;
+
+	if (mMeshLoader && mMeshLoader->GetSimplifyLod())
+		SimplifySharedSections(LodIndices);
+
 	quint16 NumSections[LC_NUM_MESH_LODS];
 	int NumIndices = 0;
 
@@ -836,14 +1160,23 @@ lcMesh* lcLibraryMeshData::CreateMesh()
 			strcpy(FinalSection.Name, Section->mMaterial->Name);
 		};
 
+		// The extra levels only exist for parts where simplifying removed something.
+		if (LodIdx > LC_MESH_LOD_LOW && LodIndices[LodIdx].empty())
+		{
+			NumSections[LodIdx] = 0;
+			continue;
+		}
+
 		for (const std::unique_ptr<lcMeshLoaderSection>& Section : mData[LC_MESHDATA_SHARED].mSections)
 		{
-			NumIndices += Section->mIndices.GetSize();
+			NumIndices += GetSharedSectionIndices(Section.get(), LodIdx, LodIndices).second;
 
 			AddFinalSection(Section.get(), FinalSections[LodIdx]);
 		}
 
-		for (const std::unique_ptr<lcMeshLoaderSection>& Section : mData[LodIdx].mSections)
+		const lcMeshDataType MeshDataType = (LodIdx >= LC_MESH_LOD_LOW) ? LC_MESHDATA_LOW : LC_MESHDATA_HIGH;
+
+		for (const std::unique_ptr<lcMeshLoaderSection>& Section : mData[MeshDataType].mSections)
 		{
 			NumIndices += Section->mIndices.GetSize();
 
@@ -899,20 +1232,32 @@ lcMesh* lcLibraryMeshData::CreateMesh()
 	}
 
 	if (Mesh->mIndexType == GL_UNSIGNED_SHORT)
-		WriteSections<quint16>(Mesh, FinalSections, BaseVertices, BaseConditionalVertices);
+		WriteSections<quint16>(Mesh, FinalSections, BaseVertices, BaseConditionalVertices, LodIndices);
 	else
-		WriteSections<quint32>(Mesh, FinalSections, BaseVertices, BaseConditionalVertices);
+		WriteSections<quint32>(Mesh, FinalSections, BaseVertices, BaseConditionalVertices, LodIndices);
+
+	if (mOptimizeVertexCache)
+	{
+		if (Mesh->mIndexType == GL_UNSIGNED_SHORT)
+			OptimizeVertexCache<quint16>(Mesh);
+		else
+			OptimizeVertexCache<quint32>(Mesh);
+	}
+
+	Mesh->CreateClusters();
 
 	if (mHasStyleStud)
 		Mesh->mFlags |= lcMeshFlag::HasStyleStud;
 
+	Mesh->mInstances = mInstances;
+
 	UpdateMeshBoundingBox(Mesh);
 
 	return Mesh;
 }
 
 template<typename IndexType>
-void lcLibraryMeshData::WriteSections(lcMesh* Mesh, const lcArray<lcMeshLoaderFinalSection> (&FinalSections)[LC_NUM_MESH_LODS], int(&BaseVertices)[LC_NUM_MESHDATA_TYPES], int(&BaseConditionalVertices)[LC_NUM_MESHDATA_TYPES])
+void lcLibraryMeshData::WriteSections(lcMesh* Mesh, const lcArray<lcMeshLoaderFinalSection> (&FinalSections)[LC_NUM_MESH_LODS], int(&BaseVertices)[LC_NUM_MESHDATA_TYPES], int(&BaseConditionalVertices)[LC_NUM_MESHDATA_TYPES], const lcMeshLoaderLodIndices& LodIndices)
 {
 	int NumIndices = 0;
 
@@ -944,7 +1289,7 @@ void lcLibraryMeshData::WriteSections(lcMesh* Mesh, const lcArray<lcMeshLoaderFi
 
 			IndexType* Index = (IndexType*)Mesh->mIndexData + NumIndices;
 
-			const auto AddSection = [&DstSection, &Index, &BaseVertices, &BaseConditionalVertices](lcMeshLoaderSection* SrcSection, lcMeshDataType SrcDataType)
+			const auto AddSection = [&DstSection, &Index, &BaseVertices, &BaseConditionalVertices](const quint32* SrcIndices, int SrcIndexCount, lcMeshDataType SrcDataType)
 			{
 				switch (DstSection.PrimitiveType)
 				{
@@ -953,8 +1298,8 @@ void lcLibraryMeshData::WriteSections(lcMesh* Mesh, const lcArray<lcMeshLoaderFi
 					{
 						const IndexType BaseVertex = BaseVertices[SrcDataType];
 
-						for (int IndexIdx = 0; IndexIdx < SrcSection->mIndices.GetSize(); IndexIdx++)
-							*Index++ = BaseVertex + SrcSection->mIndices[IndexIdx];
+						for (int IndexIdx = 0; IndexIdx < SrcIndexCount; IndexIdx++)
+							*Index++ = BaseVertex + SrcIndices[IndexIdx];
 					}
 					break;
 
@@ -962,15 +1307,15 @@ void lcLibraryMeshData::WriteSections(lcMesh* Mesh, const lcArray<lcMeshLoaderFi
 					{
 						const IndexType BaseVertex = BaseConditionalVertices[SrcDataType];
 
-						for (int IndexIdx = 0; IndexIdx < SrcSection->mIndices.GetSize(); IndexIdx++)
-							*Index++ = BaseVertex + SrcSection->mIndices[IndexIdx];
+						for (int IndexIdx = 0; IndexIdx < SrcIndexCount; IndexIdx++)
+							*Index++ = BaseVertex + SrcIndices[IndexIdx];
 					}
 					break;
 
 					case LC_MESH_TEXTURED_TRIANGLES:
 					{
-						for (int IndexIdx = 0; IndexIdx < SrcSection->mIndices.GetSize(); IndexIdx++)
-							*Index++ = SrcSection->mIndices[IndexIdx];
+						for (int IndexIdx = 0; IndexIdx < SrcIndexCount; IndexIdx++)
+							*Index++ = SrcIndices[IndexIdx];
 					}
 					break;
 
@@ -978,18 +1323,23 @@ void lcLibraryMeshData::WriteSections(lcMesh* Mesh, const lcArray<lcMeshLoaderFi
 						break;
 				}
 
-				DstSection.NumIndices += SrcSection->mIndices.GetSize();
+				DstSection.NumIndices += SrcIndexCount;
 			};
 
 			for (const std::unique_ptr<lcMeshLoaderSection>& Section : mData[LC_MESHDATA_SHARED].mSections)
-				if (FinalSection.PrimitiveType == Section->mPrimitiveType && FinalSection.Color == Section->mMaterial->Color && !strcmp(FinalSection.Name, Section->mMaterial->Name))
-					AddSection(Section.get(), LC_MESHDATA_SHARED);
+			{
+				if (FinalSection.PrimitiveType != Section->mPrimitiveType || FinalSection.Color != Section->mMaterial->Color || strcmp(FinalSection.Name, Section->mMaterial->Name))
+					continue;
 
-			const lcMeshDataType MeshDataType = (LodIdx == LC_MESH_LOD_LOW) ? LC_MESHDATA_LOW : LC_MESHDATA_HIGH;
+				const std::pair<const quint32*, int> Indices = GetSharedSectionIndices(Section.get(), LodIdx, LodIndices);
+				AddSection(Indices.first, Indices.second, LC_MESHDATA_SHARED);
+			}
+
+			const lcMeshDataType MeshDataType = (LodIdx >= LC_MESH_LOD_LOW) ? LC_MESHDATA_LOW : LC_MESHDATA_HIGH;
 
 			for (const std::unique_ptr<lcMeshLoaderSection>& Section : mData[MeshDataType].mSections)
 				if (FinalSection.PrimitiveType == Section->mPrimitiveType && FinalSection.Color == Section->mMaterial->Color && !strcmp(FinalSection.Name, Section->mMaterial->Name))
-					AddSection(Section.get(), MeshDataType);
+					AddSection(Section->mIndices.begin(), Section->mIndices.GetSize(), MeshDataType);
 
 			if (DstSection.PrimitiveType == LC_MESH_TRIANGLES || DstSection.PrimitiveType == LC_MESH_TEXTURED_TRIANGLES)
 			{
@@ -1014,6 +1364,93 @@ void lcLibraryMeshData::WriteSections(lcMesh* Mesh, const lcArray<lcMeshLoaderFi
 	}
 }
 
+template<typename IndexType>
+void lcLibraryMeshData::OptimizeVertexCache(lcMesh* Mesh)
+{
+	lcMeshLoaderStats LocalStats;
+	lcMeshLoaderStats& Stats = mMeshLoader ? mMeshLoader->GetStats() : LocalStats;
+
+	for (int LodIdx = 0; LodIdx < LC_NUM_MESH_LODS; LodIdx++)
+	{
+		const lcMeshLod& Lod = Mesh->mLods[LodIdx];
+
+		for (int SectionIdx = 0; SectionIdx < Lod.NumSections; SectionIdx++)
+		{
+			const lcMeshSection& Section = Lod.Sections[SectionIdx];
+
+			if (Section.PrimitiveType != LC_MESH_TRIANGLES && Section.PrimitiveType != LC_MESH_TEXTURED_TRIANGLES)
+				continue;
+
+			IndexType* Indices = reinterpret_cast<IndexType*>(static_cast<char*>(Mesh->mIndexData) + Section.IndexOffset);
+			const int VertexCount = (Section.PrimitiveType == LC_MESH_TRIANGLES) ? Mesh->mNumVertices : Mesh->mNumTexturedVertices;
+
+			Stats.OptimizedTriangles += Section.NumIndices / 3;
+			Stats.CacheMissesBefore += lcGetVertexCacheMisses(Indices, Section.NumIndices, VertexCount, LC_VERTEX_CACHE_FIFO_SIZE);
+
+			lcOptimizeVertexCache(Indices, Section.NumIndices, VertexCount);
+
+			Stats.CacheMissesAfter += lcGetVertexCacheMisses(Indices, Section.NumIndices, VertexCount, LC_VERTEX_CACHE_FIFO_SIZE);
+		}
+	}
+
+	if (!mMeshLoader)
+		lcGetPiecesLibrary()->AddMeshLoaderStats(LocalStats);
+
+	// Renumber the vertices in the order they are first drawn so fetches walk the vertex buffer linearly.
+	std::vector<int> VertexRemap(Mesh->mNumVertices, -1);
+	std::vector<int> TexturedVertexRemap(Mesh->mNumTexturedVertices, -1);
+	int VertexCount = 0;
+	int TexturedVertexCount = 0;
+
+	for (int LodIdx = 0; LodIdx < LC_NUM_MESH_LODS; LodIdx++)
+	{
+		const lcMeshLod& Lod = Mesh->mLods[LodIdx];
+
+		for (int SectionIdx = 0; SectionIdx < Lod.NumSections; SectionIdx++)
+		{
+			const lcMeshSection& Section = Lod.Sections[SectionIdx];
+
+			if (Section.PrimitiveType == LC_MESH_CONDITIONAL_LINES)
+				continue;
+
+			const bool Textured = (Section.PrimitiveType == LC_MESH_TEXTURED_TRIANGLES);
+			std::vector<int>& Remap = Textured ? TexturedVertexRemap : VertexRemap;
+			int& RemapCount = Textured ? TexturedVertexCount : VertexCount;
+			IndexType* Indices = reinterpret_cast<IndexType*>(static_cast<char*>(Mesh->mIndexData) + Section.IndexOffset);
+
+			for (int IndexIdx = 0; IndexIdx < Section.NumIndices; IndexIdx++)
+			{
+				int& NewIndex = Remap[Indices[IndexIdx]];
+
+				if (NewIndex == -1)
+					NewIndex = RemapCount++;
+
+				Indices[IndexIdx] = static_cast<IndexType>(NewIndex);
+			}
+		}
+	}
+
+	for (int& NewIndex : VertexRemap)
+		if (NewIndex == -1)
+			NewIndex = VertexCount++;
+
+	for (int& NewIndex : TexturedVertexRemap)
+		if (NewIndex == -1)
+			NewIndex = TexturedVertexCount++;
+
+	lcVertex* Vertices = static_cast<lcVertex*>(Mesh->mVertexData);
+	const std::vector<lcVertex> OldVertices(Vertices, Vertices + Mesh->mNumVertices);
+
+	for (int VertexIdx = 0; VertexIdx < Mesh->mNumVertices; VertexIdx++)
+		Vertices[VertexRemap[VertexIdx]] = OldVertices[VertexIdx];
+
+	lcVertexTextured* TexturedVertices = reinterpret_cast<lcVertexTextured*>(Vertices + Mesh->mNumVertices);
+	const std::vector<lcVertexTextured> OldTexturedVertices(TexturedVertices, TexturedVertices + Mesh->mNumTexturedVertices);
+
+	for (int VertexIdx = 0; VertexIdx < Mesh->mNumTexturedVertices; VertexIdx++)
+		TexturedVertices[TexturedVertexRemap[VertexIdx]] = OldTexturedVertices[VertexIdx];
+}
+
 void lcLibraryMeshData::UpdateMeshBoundingBox(lcMesh* Mesh)
 {
 	lcVector3 MeshMin(FLT_MAX, FLT_MAX, FLT_MAX), MeshMax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
@@ -1046,6 +1483,21 @@ void lcLibraryMeshData::UpdateMeshBoundingBox(lcMesh* Mesh)
 		}
 	}
 
+	for (const lcMeshInstance& Instance : Mesh->mInstances)
+	{
+		lcVector3 Points[8];
+		lcGetBoxCorners(Instance.Mesh->mBoundingBox, Points);
+
+		for (const lcVector3& Point : Points)
+		{
+			const lcVector3 Position = lcMul31(Point, Instance.Transform);
+			MeshMin = lcMin(Position, MeshMin);
+			MeshMax = lcMax(Position, MeshMax);
+		}
+
+		UpdatedBoundingBox = true;
+	}
+
 	if (!UpdatedBoundingBox)
 		MeshMin = MeshMax = lcVector3(0.0f, 0.0f, 0.0f);
 
@@ -1110,6 +1562,193 @@ lcMeshLoader::lcMeshLoader(lcLibraryMeshData& MeshData, bool Optimize, Project*
 	: mCurrentProject(CurrentProject), mSearchProjectFolder(SearchProjectFolder), mMeshData(MeshData), mOptimize(Optimize)
 {
 	MeshData.SetMeshLoader(this);
+	mVertexCacheStamp = lcGetPiecesLibrary()->GetPrimitiveStamp();
+}
+
+lcMeshLoader::~lcMeshLoader()
+{
+	mMeshData.SetMeshLoader(nullptr);
+
+	lcGetPiecesLibrary()->AddMeshLoaderStats(mStats);
+}
+
+// Returns the vertices of a primitive with the rotation and scale of a transform applied, the translation still has
+// to be added by the caller. Primitives are usually referenced many times with the same orientation so the results
+// are cached for the lifetime of the loader.
+const std::vector<lcMeshLoaderVertex>& lcMeshLoader::GetTransformedVertices(const lcMeshLoaderTypeData& Data, const lcMatrix44& Transform, bool InvertNormals)
+{
+	// The cache is keyed on the address of the primitive data, drop it if a primitive was released since it could be reused.
+	const int PrimitiveStamp = lcGetPiecesLibrary()->GetPrimitiveStamp();
+
+	if (mVertexCacheStamp != PrimitiveStamp)
+	{
+		mVertexCache.clear();
+		mVertexCacheStamp = PrimitiveStamp;
+	}
+
+	lcVertexCacheKey Key;
+	bool TranslationOnly = true;
+
+	Key.Data = &Data;
+	Key.InvertNormals = InvertNormals;
+
+	for (int Row = 0; Row < 3; Row++)
+	{
+		for (int Column = 0; Column < 3; Column++)
+		{
+			memcpy(&Key.Rotation[Row * 3 + Column], &Transform.r[Row][Column], sizeof(float));
+
+			if (Transform.r[Row][Column] != (Row == Column ? 1.0f : 0.0f))
+				TranslationOnly = false;
+		}
+	}
+
+	if (TranslationOnly)
+		mStats.TranslationOnly++;
+
+	std::map<lcVertexCacheKey, std::vector<lcMeshLoaderVertex>>::iterator CacheIt = mVertexCache.find(Key);
+
+	if (CacheIt != mVertexCache.end() && CacheIt->second.size() == static_cast<size_t>(Data.mVertices.GetSize()))
+	{
+		mStats.VertexCacheHits++;
+		return CacheIt->second;
+	}
+
+	mStats.VertexCacheMisses++;
+
+	std::vector<lcMeshLoaderVertex>& Vertices = mVertexCache[Key];
+	lcTransformVertices(Data, Transform, InvertNormals, Vertices);
+
+	return Vertices;
+}
+
+static bool lcIsSpace(char c)
+{
+	return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+// Same as sscanf("%d") with a base of 10 and sscanf("%i") with a base of 0.
+static bool lcParseInt(const char*& Text, int& Value, int Base)
+{
+	char* End;
+	const long Result = strtol(Text, &End, Base);
+
+	if (End == Text)
+		return false;
+
+	Value = static_cast<int>(Result);
+	Text = End;
+
+	return true;
+}
+
+// Same as sscanf("%f"). Plain decimals with up to 7 significant digits are converted with a single exact division,
+// which rounds the same way as strtof, and everything else is left to strtof.
+static bool lcParseFloat(const char*& Text, float& Value)
+{
+	constexpr float Powers[] = { 1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f };
+	const char* Ch = Text;
+
+	while (lcIsSpace(*Ch))
+		Ch++;
+
+	const bool Negative = (*Ch == '-');
+
+	if (*Ch == '-' || *Ch == '+')
+		Ch++;
+
+	quint32 Mantissa = 0;
+	int DigitCount = 0;
+	int FractionDigits = 0;
+	bool Fast = true;
+
+	for (; *Ch >= '0' && *Ch <= '9' && Fast; Ch++, DigitCount++)
+	{
+		Mantissa = Mantissa * 10 + (*Ch - '0');
+		Fast = (Mantissa <= (1u << 24));
+	}
+
+	if (*Ch == '.' && Fast)
+	{
+		for (Ch++; *Ch >= '0' && *Ch <= '9' && Fast; Ch++, DigitCount++, FractionDigits++)
+		{
+			Mantissa = Mantissa * 10 + (*Ch - '0');
+			Fast = (Mantissa <= (1u << 24)) && FractionDigits + 1 < static_cast<int>(LC_ARRAY_COUNT(Powers));
+		}
+	}
+
+	if (Fast && DigitCount && *Ch != 'e' && *Ch != 'E' && *Ch != 'x' && *Ch != 'X')
+	{
+		Value = static_cast<float>(Mantissa) / Powers[FractionDigits];
+
+		if (Negative)
+			Value = -Value;
+
+		Text = Ch;
+
+		return true;
+	}
+
+	char* End;
+	const float Result = strtof(Text, &End);
+
+	if (End == Text)
+		return false;
+
+	Value = Result;
+	Text = End;
+
+	return true;
+}
+
+static bool lcParsePoints(const char*& Text, lcVector3* Points, int PointCount)
+{
+	for (int PointIdx = 0; PointIdx < PointCount; PointIdx++)
+		if (!lcParseFloat(Text, Points[PointIdx].x) || !lcParseFloat(Text, Points[PointIdx].y) || !lcParseFloat(Text, Points[PointIdx].z))
+			return false;
+
+	return true;
+}
+
+// Same as sscanf("%s") but truncates to the buffer size.
+static bool lcParseString(const char*& Text, char* Buffer, size_t BufferSize)
+{
+	const char* Ch = Text;
+	size_t Length = 0;
+
+	Buffer[0] = 0;
+
+	while (lcIsSpace(*Ch))
+		Ch++;
+
+	if (!*Ch)
+		return false;
+
+	for (; *Ch && !lcIsSpace(*Ch); Ch++)
+		if (Length + 1 < BufferSize)
+			Buffer[Length++] = *Ch;
+
+	Buffer[Length] = 0;
+	Text = Ch;
+
+	return true;
+}
+
+static bool lcIsRigidTransform(const lcMatrix44& Transform)
+{
+	for (int Row1 = 0; Row1 < 3; Row1++)
+	{
+		const lcVector3 Axis1(Transform[Row1]);
+
+		if (fabsf(lcDot(Axis1, Axis1) - 1.0f) > 1e-3f)
+			return false;
+
+		for (int Row2 = Row1 + 1; Row2 < 3; Row2++)
+			if (fabsf(lcDot(Axis1, lcVector3(Transform[Row2]))) > 1e-3f)
+				return false;
+	}
+
+	return true;
 }
 
 bool lcMeshLoader::LoadMesh(lcFile& File, lcMeshDataType MeshDataType)
@@ -1130,13 +1769,13 @@ bool lcMeshLoader::ReadMeshData(lcFile& File, const lcMatrix44& CurrentTransform
 		if (Library->ShouldCancelLoading())
 			return false;
 
-		quint32 ColorCode, ColorCodeHex;
 		bool LastToken = false;
 		int LineType;
 
 		Line = Buffer;
+		const char* Data = Line;
 
-		if (sscanf(Line, "%d", &LineType) != 1)
+		if (!lcParseInt(Data, LineType, 10))
 			continue;
 
 		if (LineType == 0)
@@ -1223,7 +1862,10 @@ bool lcMeshLoader::ReadMeshData(lcFile& File, const lcMatrix44& CurrentTransform
 
 						lcVector3 (&Points)[3] = Map.Points;
 
-						sscanf(Token, "%f %f %f %f %f %f %f %f %f %s", &Points[0].x, &Points[0].y, &Points[0].z, &Points[1].x, &Points[1].y, &Points[1].z, &Points[2].x, &Points[2].y, &Points[2].z, Map.Name);
+						Data = Token;
+
+						if (lcParsePoints(Data, Points, 3))
+							lcParseString(Data, Map.Name, sizeof(Map.Name));
 
 						Points[0] = lcMul31(Points[0], CurrentTransform);
 						Points[1] = lcMul31(Points[1], CurrentTransform);
@@ -1242,7 +1884,10 @@ bool lcMeshLoader::ReadMeshData(lcFile& File, const lcMatrix44& CurrentTransform
 						lcVector3 (&Points)[3] = Map.Points;
 						float& Angle = Map.Angles[0];
 
-						sscanf(Token, "%f %f %f %f %f %f %f %f %f %f %s", &Points[0].x, &Points[0].y, &Points[0].z, &Points[1].x, &Points[1].y, &Points[1].z, &Points[2].x, &Points[2].y, &Points[2].z, &Angle, Map.Name);
+						Data = Token;
+
+						if (lcParsePoints(Data, Points, 3) && lcParseFloat(Data, Angle))
+							lcParseString(Data, Map.Name, sizeof(Map.Name));
 
 						Points[0] = lcMul31(Points[0], CurrentTransform);
 						Points[1] = lcMul31(Points[1], CurrentTransform);
@@ -1262,7 +1907,10 @@ bool lcMeshLoader::ReadMeshData(lcFile& File, const lcMatrix44& CurrentTransform
 						float& Angle1 = Map.Angles[0];
 						float& Angle2 = Map.Angles[1];
 
-						sscanf(Token, "%f %f %f %f %f %f %f %f %f %f %f %s", &Points[0].x, &Points[0].y, &Points[0].z, &Points[1].x, &Points[1].y, &Points[1].z, &Points[2].x, &Points[2].y, &Points[2].z, &Angle1, &Angle2, Map.Name);
+						Data = Token;
+
+						if (lcParsePoints(Data, Points, 3) && lcParseFloat(Data, Angle1) && lcParseFloat(Data, Angle2))
+							lcParseString(Data, Map.Name, sizeof(Map.Name));
 
 						Points[0] = lcMul31(Points[0], CurrentTransform);
 						Points[1] = lcMul31(Points[1], CurrentTransform);
@@ -1321,19 +1969,28 @@ bool lcMeshLoader::ReadMeshData(lcFile& File, const lcMatrix44& CurrentTransform
 				continue;
 		}
 
-		if (sscanf(Line, "%d %d", &LineType, &ColorCode) != 2)
+		Data = Line;
+		int ColorValue, ColorValueHex;
+
+		if (!lcParseInt(Data, LineType, 10))
+			continue;
+
+		const char* ColorToken = Data;
+
+		if (!lcParseInt(Data, ColorValue, 10))
 			continue;
 
 		if (LineType < 1 || LineType > 5)
 			continue;
 
-		if (ColorCode == 0)
-		{
-			sscanf(Line, "%d %i", &LineType, &ColorCodeHex);
+		// Parse the color again to skip hex codes and to find where the coordinates start.
+		Data = ColorToken;
+		lcParseInt(Data, ColorValueHex, 0);
 
-			if (ColorCode != ColorCodeHex)
-				ColorCode = ColorCodeHex | LC_COLOR_DIRECT;
-		}
+		quint32 ColorCode = ColorValue;
+
+		if (ColorCode == 0 && ColorCode != static_cast<quint32>(ColorValueHex))
+			ColorCode = static_cast<quint32>(ColorValueHex) | LC_COLOR_DIRECT;
 
 		if (ColorCode == 16)
 			ColorCode = CurrentColorCode;
@@ -1359,7 +2016,6 @@ bool lcMeshLoader::ReadMeshData(lcFile& File, const lcMatrix44& CurrentTransform
 //			}
 		}
 
-		int Dummy;
 		lcVector3 Points[4];
 
 		switch (LineType)
@@ -1369,7 +2025,14 @@ bool lcMeshLoader::ReadMeshData(lcFile& File, const lcMatrix44& CurrentTransform
 			char OriginalFileName[LC_MAXPATH];
 			float fm[12];
 
-			sscanf(Line, "%d %i %f %f %f %f %f %f %f %f %f %f %f %f %s", &LineType, &Dummy, &fm[0], &fm[1], &fm[2], &fm[3], &fm[4], &fm[5], &fm[6], &fm[7], &fm[8], &fm[9], &fm[10], &fm[11], OriginalFileName);
+			bool Valid = true;
+
+			for (float& Value : fm)
+				if (Valid)
+					Valid = lcParseFloat(Data, Value);
+
+			if (!Valid || !lcParseString(Data, OriginalFileName, sizeof(OriginalFileName)))
+				OriginalFileName[0] = 0;
 
 			char FileName[LC_MAXPATH];
 			strcpy(FileName, OriginalFileName);
@@ -1398,8 +2061,20 @@ bool lcMeshLoader::ReadMeshData(lcFile& File, const lcMatrix44& CurrentTransform
 				if (Primitive->mState != lcPrimitiveState::Loaded && !Library->LoadPrimitive(Primitive))
 					break;
 
+				Primitive->mLastUsed.storeRelease(Library->GetMemoryStamp());
+
 				if (Primitive->mStud)
-					mMeshData.AddMeshDataNoDuplicateCheck(Primitive->mMeshData, IncludeTransform, ColorCode, Mirror ^ InvertNext, InvertNext, TextureMap, MeshDataType);
+				{
+					std::shared_ptr<lcMesh> PrimitiveMesh;
+
+					if (mInstanceStuds && MeshDataType == LC_MESHDATA_SHARED && ColorCode == 16 && !Mirror && !InvertNext && !Primitive->mMeshData.mHasTextures && lcIsRigidTransform(IncludeTransform))
+						PrimitiveMesh = Library->GetPrimitiveMesh(Primitive);
+
+					if (PrimitiveMesh)
+						mMeshData.mInstances.emplace_back(lcMeshInstance{ std::move(PrimitiveMesh), lcMatrix44LDrawToLeoCAD(IncludeTransform) });
+					else
+						mMeshData.AddMeshDataNoDuplicateCheck(Primitive->mMeshData, IncludeTransform, ColorCode, Mirror ^ InvertNext, InvertNext, TextureMap, MeshDataType);
+				}
 				else if (!Primitive->mSubFile)
 				{
 					if (mOptimize)
@@ -1417,7 +2092,7 @@ bool lcMeshLoader::ReadMeshData(lcFile& File, const lcMatrix44& CurrentTransform
 		} break;
 
 		case 2:
-			sscanf(Line, "%d %i %f %f %f %f %f %f", &LineType, &Dummy, &Points[0].x, &Points[0].y, &Points[0].z, &Points[1].x, &Points[1].y, &Points[1].z);
+			lcParsePoints(Data, Points, 2);
 
 			Points[0] = lcMul31(Points[0], CurrentTransform);
 			Points[1] = lcMul31(Points[1], CurrentTransform);
@@ -1426,8 +2101,7 @@ bool lcMeshLoader::ReadMeshData(lcFile& File, const lcMatrix44& CurrentTransform
 			break;
 
 		case 3:
-			sscanf(Line, "%d %i %f %f %f %f %f %f %f %f %f", &LineType, &Dummy, &Points[0].x, &Points[0].y, &Points[0].z,
-				   &Points[1].x, &Points[1].y, &Points[1].z, &Points[2].x, &Points[2].y, &Points[2].z);
+			lcParsePoints(Data, Points, 3);
 
 			Points[0] = lcMul31(Points[0], CurrentTransform);
 			Points[1] = lcMul31(Points[1], CurrentTransform);
@@ -1446,8 +2120,7 @@ bool lcMeshLoader::ReadMeshData(lcFile& File, const lcMatrix44& CurrentTransform
 			break;
 
 		case 4:
-			sscanf(Line, "%d %i %f %f %f %f %f %f %f %f %f %f %f %f", &LineType, &Dummy, &Points[0].x, &Points[0].y, &Points[0].z,
-				   &Points[1].x, &Points[1].y, &Points[1].z, &Points[2].x, &Points[2].y, &Points[2].z, &Points[3].x, &Points[3].y, &Points[3].z);
+			lcParsePoints(Data, Points, 4);
 
 			Points[0] = lcMul31(Points[0], CurrentTransform);
 			Points[1] = lcMul31(Points[1], CurrentTransform);
@@ -1467,8 +2140,7 @@ bool lcMeshLoader::ReadMeshData(lcFile& File, const lcMatrix44& CurrentTransform
 			break;
 
 		case 5:
-			sscanf(Line, "%d %i %f %f %f %f %f %f %f %f %f %f %f %f", &LineType, &Dummy, &Points[0].x, &Points[0].y, &Points[0].z,
-				   &Points[1].x, &Points[1].y, &Points[1].z, &Points[2].x, &Points[2].y, &Points[2].z, &Points[3].x, &Points[3].y, &Points[3].z);
+			lcParsePoints(Data, Points, 4);
 
 			Points[0] = lcMul31(Points[0], CurrentTransform);
 			Points[1] = lcMul31(Points[1], CurrentTransform);
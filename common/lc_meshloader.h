@@ -34,6 +34,18 @@ struct lcMeshLoaderConditionalVertex
 	lcVector3 Position[4];
 };
 
+struct lcMeshLoaderStats
+{
+	int VertexCacheHits = 0;
+	int VertexCacheMisses = 0;
+	int TranslationOnly = 0;
+	qint64 OptimizedTriangles = 0;
+	qint64 CacheMissesBefore = 0;
+	qint64 CacheMissesAfter = 0;
+	int TexturedMeshes = 0;
+	qint64 TexturedVertexTime = 0;
+};
+
 enum class lcMeshLoaderMaterialType
 {
 	Solid,
@@ -115,6 +127,25 @@ public:
 		mSections.clear();
 		mVertices.RemoveAll();
 		mConditionalVertices.RemoveAll();
+		mVertexHashBuckets.clear();
+		mVertexHashNext.clear();
+	}
+
+	void ReleaseVertexHash()
+	{
+		std::vector<int>().swap(mVertexHashBuckets);
+		std::vector<int>().swap(mVertexHashNext);
+	}
+
+	size_t GetMemorySize() const
+	{
+		size_t Size = mVertices.GetSize() * sizeof(lcMeshLoaderVertex) + mConditionalVertices.GetSize() * sizeof(lcMeshLoaderConditionalVertex);
+		Size += (mVertexHashBuckets.size() + mVertexHashNext.size()) * sizeof(int);
+
+		for (const std::unique_ptr<lcMeshLoaderSection>& Section : mSections)
+			Size += Section->mIndices.GetSize() * sizeof(quint32);
+
+		return Size;
 	}
 
 	void SetMeshData(lcLibraryMeshData* MeshData)
@@ -138,9 +169,17 @@ public:
 	lcArray<lcMeshLoaderConditionalVertex> mConditionalVertices;
 
 protected:
+	void UpdateVertexHash();
+	int FindVertex(const lcVector3& Position, const lcVector3* Normal);
+
 	lcLibraryMeshData* mMeshData = nullptr;
+	std::vector<int> mVertexHashBuckets;
+	std::vector<int> mVertexHashNext;
 };
 
+// Simplified indices of the shared sections for each LOD level, levels without an entry reuse the previous level.
+typedef std::map<const lcMeshLoaderSection*, std::vector<quint32>> lcMeshLoaderLodIndices[LC_NUM_MESH_LODS];
+
 class lcLibraryMeshData
 {
 public:
@@ -162,7 +201,7 @@ public:
 			if (!Data.IsEmpty())
 				return false;
 
-		return true;
+		return mInstances.empty();
 	}
 
 	void Clear()
@@ -170,15 +209,47 @@ public:
 		for (lcMeshLoaderTypeData& Data : mData)
 			Data.Clear();
 
+		mInstances.clear();
 		mHasTextures = false;
 		mHasStyleStud = false;
 	}
 
+	size_t GetMemorySize() const
+	{
+		size_t Size = mTexturedVertices.GetSize() * sizeof(lcMeshLoaderTexturedVertex) + mInstances.size() * sizeof(lcMeshInstance);
+		Size += (mTexturedVertexHashBuckets.size() + mTexturedVertexHashNext.size()) * sizeof(int);
+
+		for (const lcMeshLoaderTypeData& Data : mData)
+			Size += Data.GetMemorySize();
+
+		return Size;
+	}
+
 	void SetMeshLoader(lcMeshLoader* MeshLoader)
 	{
 		mMeshLoader = MeshLoader;
 	}
 
+	lcMeshLoader* GetMeshLoader() const
+	{
+		return mMeshLoader;
+	}
+
+	// The hashes are only needed while merging vertices, they are rebuilt if more data is added later.
+	void ReleaseVertexHashes()
+	{
+		for (lcMeshLoaderTypeData& Data : mData)
+			Data.ReleaseVertexHash();
+
+		std::vector<int>().swap(mTexturedVertexHashBuckets);
+		std::vector<int>().swap(mTexturedVertexHashNext);
+	}
+
+	void SetOptimizeVertexCache(bool OptimizeVertexCache)
+	{
+		mOptimizeVertexCache = OptimizeVertexCache;
+	}
+
 	lcMesh* CreateMesh();
 	void AddVertices(lcMeshDataType MeshDataType, int VertexCount, int* BaseVertex, lcMeshLoaderVertex** VertexBuffer);
 	void AddIndices(lcMeshDataType MeshDataType, lcMeshPrimitiveType PrimitiveType, quint32 ColorCode, int IndexCount, quint32** IndexBuffer);
@@ -189,22 +260,31 @@ public:
 	lcMeshLoaderMaterial* GetTexturedMaterial(quint32 ColorCode, const lcMeshLoaderTextureMap& TextureMap);
 
 	std::array<lcMeshLoaderTypeData, LC_NUM_MESHDATA_TYPES> mData;
+	std::vector<lcMeshInstance> mInstances;
 	bool mHasTextures;
 	bool mHasStyleStud;
 
 protected:
 	lcMeshLoader* mMeshLoader = nullptr;
+	bool mOptimizeVertexCache = false;
 	std::vector<std::unique_ptr<lcMeshLoaderMaterial>> mMaterials;
 	lcArray<lcMeshLoaderTexturedVertex> mTexturedVertices;
+	std::vector<int> mTexturedVertexHashBuckets;
+	std::vector<int> mTexturedVertexHashNext;
 
 	void GenerateTexturedVertices();
 	void GeneratePlanarTexcoords(lcMeshLoaderSection* Section, const lcMeshLoaderTypeData& Data);
 	void GenerateCylindricalTexcoords(lcMeshLoaderSection* Section, const lcMeshLoaderTypeData& Data);
 	void GenerateSphericalTexcoords(lcMeshLoaderSection* Section, const lcMeshLoaderTypeData& Data);
 	quint32 AddTexturedVertex(const lcVector3& Position, const lcVector3& Normal, const lcVector2& TexCoords);
+	void SimplifySharedSections(lcMeshLoaderLodIndices& LodIndices) const;
+	static std::pair<const quint32*, int> GetSharedSectionIndices(const lcMeshLoaderSection* Section, int LodIndex, const lcMeshLoaderLodIndices& LodIndices);
 
 	template<typename IndexType>
-	void WriteSections(lcMesh* Mesh, const lcArray<lcMeshLoaderFinalSection> (&FinalSections)[LC_NUM_MESH_LODS], int (&BaseVertices)[LC_NUM_MESHDATA_TYPES], int (&BaseConditionalVertices)[LC_NUM_MESHDATA_TYPES]);
+	void WriteSections(lcMesh* Mesh, const lcArray<lcMeshLoaderFinalSection> (&FinalSections)[LC_NUM_MESH_LODS], int (&BaseVertices)[LC_NUM_MESHDATA_TYPES], int (&BaseConditionalVertices)[LC_NUM_MESHDATA_TYPES], const lcMeshLoaderLodIndices& LodIndices);
+
+	template<typename IndexType>
+	void OptimizeVertexCache(lcMesh* Mesh);
 
 	static void UpdateMeshBoundingBox(lcMesh* Mesh);
 	template<typename IndexType>
@@ -215,17 +295,66 @@ class lcMeshLoader
 {
 public:
 	lcMeshLoader(lcLibraryMeshData& MeshData, bool Optimize, Project* CurrentProject, bool SearchProjectFolder);
+	~lcMeshLoader();
+
+	lcMeshLoader(const lcMeshLoader&) = delete;
+	lcMeshLoader& operator=(const lcMeshLoader&) = delete;
 
 	bool LoadMesh(lcFile& File, lcMeshDataType MeshDataType);
 
+	void SetInstanceStuds(bool InstanceStuds)
+	{
+		mInstanceStuds = InstanceStuds;
+	}
+
+	void SetSimplifyLod(bool SimplifyLod)
+	{
+		mSimplifyLod = SimplifyLod;
+	}
+
+	bool GetSimplifyLod() const
+	{
+		return mSimplifyLod;
+	}
+
+	lcMeshLoaderStats& GetStats()
+	{
+		return mStats;
+	}
+
+	const std::vector<lcMeshLoaderVertex>& GetTransformedVertices(const lcMeshLoaderTypeData& Data, const lcMatrix44& Transform, bool InvertNormals);
+
 	Project* mCurrentProject;
 	bool mSearchProjectFolder;
 
 protected:
 	bool ReadMeshData(lcFile& File, const lcMatrix44& CurrentTransform, quint32 CurrentColorCode, bool InvertWinding, lcMeshDataType MeshDataType);
 
+	struct lcVertexCacheKey
+	{
+		const lcMeshLoaderTypeData* Data;
+		std::array<quint32, 9> Rotation;
+		bool InvertNormals;
+
+		bool operator<(const lcVertexCacheKey& Other) const
+		{
+			if (Data != Other.Data)
+				return Data < Other.Data;
+
+			if (InvertNormals != Other.InvertNormals)
+				return InvertNormals < Other.InvertNormals;
+
+			return Rotation < Other.Rotation;
+		}
+	};
+
 	std::vector<lcMeshLoaderTextureMap> mTextureStack;
+	std::map<lcVertexCacheKey, std::vector<lcMeshLoaderVertex>> mVertexCache;
+	int mVertexCacheStamp;
+	lcMeshLoaderStats mStats;
 
 	lcLibraryMeshData& mMeshData;
 	bool mOptimize;
+	bool mInstanceStuds = false;
+	bool mSimplifyLod = false;
 };
@@ -0,0 +1,187 @@
+#include "lc_global.h"
+#include "lc_meshoptimizer.h"
+
+static float lcGetVertexScore(int CachePosition, int RemainingTriangles)
+{
+	if (!RemainingTriangles)
+		return -1.0f;
+
+	float Score = 0.0f;
+
+	if (CachePosition >= 0)
+	{
+		// The last triangle's vertices get a fixed score so the next triangle doesn't strictly have to share an edge with it.
+		if (CachePosition < 3)
+			Score = 0.75f;
+		else
+			Score = powf(1.0f - (CachePosition - 3) / static_cast<float>(LC_VERTEX_CACHE_SIZE - 3), 1.5f);
+	}
+
+	// Favor vertices with few triangles left so they can be retired early instead of leaving isolated triangles.
+	Score += 2.0f * powf(static_cast<float>(RemainingTriangles), -0.5f);
+
+	return Score;
+}
+
+template<typename IndexType>
+void lcOptimizeVertexCache(IndexType* Indices, int IndexCount, int VertexCount)
+{
+	const int TriangleCount = IndexCount / 3;
+
+	if (TriangleCount < 2)
+		return;
+
+	std::vector<int> VertexTriangleOffsets(VertexCount + 1, 0);
+	std::vector<int> RemainingTriangles(VertexCount, 0);
+
+	for (int IndexIdx = 0; IndexIdx < TriangleCount * 3; IndexIdx++)
+		RemainingTriangles[Indices[IndexIdx]]++;
+
+	for (int VertexIdx = 0; VertexIdx < VertexCount; VertexIdx++)
+		VertexTriangleOffsets[VertexIdx + 1] = VertexTriangleOffsets[VertexIdx] + RemainingTriangles[VertexIdx];
+
+	std::vector<int> VertexTriangles(TriangleCount * 3);
+	std::vector<int> VertexTriangleCounts(VertexCount, 0);
+
+	for (int TriangleIdx = 0; TriangleIdx < TriangleCount; TriangleIdx++)
+	{
+		for (int CornerIdx = 0; CornerIdx < 3; CornerIdx++)
+		{
+			const IndexType Vertex = Indices[TriangleIdx * 3 + CornerIdx];
+			VertexTriangles[VertexTriangleOffsets[Vertex] + VertexTriangleCounts[Vertex]++] = TriangleIdx;
+		}
+	}
+
+	std::vector<float> VertexScores(VertexCount);
+
+	for (int VertexIdx = 0; VertexIdx < VertexCount; VertexIdx++)
+		VertexScores[VertexIdx] = lcGetVertexScore(-1, RemainingTriangles[VertexIdx]);
+
+	std::vector<float> TriangleScores(TriangleCount);
+	std::vector<bool> TriangleAdded(TriangleCount, false);
+
+	for (int TriangleIdx = 0; TriangleIdx < TriangleCount; TriangleIdx++)
+	{
+		const IndexType* Triangle = Indices + TriangleIdx * 3;
+		TriangleScores[TriangleIdx] = VertexScores[Triangle[0]] + VertexScores[Triangle[1]] + VertexScores[Triangle[2]];
+	}
+
+	std::vector<IndexType> SortedIndices;
+	SortedIndices.reserve(TriangleCount * 3);
+
+	std::vector<IndexType> Cache, NewCache;
+	Cache.reserve(LC_VERTEX_CACHE_SIZE + 3);
+	NewCache.reserve(LC_VERTEX_CACHE_SIZE + 3);
+
+	int BestTriangle = 0;
+	int NextTriangle = 0;
+
+	for (int TriangleIdx = 1; TriangleIdx < TriangleCount; TriangleIdx++)
+		if (TriangleScores[TriangleIdx] > TriangleScores[BestTriangle])
+			BestTriangle = TriangleIdx;
+
+	while (BestTriangle != -1)
+	{
+		const IndexType* Triangle = Indices + BestTriangle * 3;
+
+		TriangleAdded[BestTriangle] = true;
+		SortedIndices.insert(SortedIndices.end(), Triangle, Triangle + 3);
+
+		NewCache.clear();
+
+		for (int CornerIdx = 0; CornerIdx < 3; CornerIdx++)
+		{
+			const IndexType Vertex = Triangle[CornerIdx];
+			int* Triangles = VertexTriangles.data() + VertexTriangleOffsets[Vertex];
+			int& Count = RemainingTriangles[Vertex];
+
+			for (int AdjacentIdx = 0; AdjacentIdx < Count; AdjacentIdx++)
+			{
+				if (Triangles[AdjacentIdx] == BestTriangle)
+				{
+					std::swap(Triangles[AdjacentIdx], Triangles[Count - 1]);
+					Count--;
+					break;
+				}
+			}
+
+			NewCache.push_back(Vertex);
+		}
+
+		for (const IndexType Vertex : Cache)
+			if (Vertex != Triangle[0] && Vertex != Triangle[1] && Vertex != Triangle[2])
+				NewCache.push_back(Vertex);
+
+		std::swap(Cache, NewCache);
+
+		for (int CacheIdx = 0; CacheIdx < static_cast<int>(Cache.size()); CacheIdx++)
+		{
+			const IndexType Vertex = Cache[CacheIdx];
+			const int CachePosition = CacheIdx < LC_VERTEX_CACHE_SIZE ? CacheIdx : -1;
+			const float ScoreDelta = lcGetVertexScore(CachePosition, RemainingTriangles[Vertex]) - VertexScores[Vertex];
+			VertexScores[Vertex] += ScoreDelta;
+
+			const int* Triangles = VertexTriangles.data() + VertexTriangleOffsets[Vertex];
+
+			for (int AdjacentIdx = 0; AdjacentIdx < RemainingTriangles[Vertex]; AdjacentIdx++)
+				TriangleScores[Triangles[AdjacentIdx]] += ScoreDelta;
+		}
+
+		if (Cache.size() > LC_VERTEX_CACHE_SIZE)
+			Cache.resize(LC_VERTEX_CACHE_SIZE);
+
+		BestTriangle = -1;
+		float BestScore = -1.0f;
+
+		for (const IndexType Vertex : Cache)
+		{
+			const int* Triangles = VertexTriangles.data() + VertexTriangleOffsets[Vertex];
+
+			for (int AdjacentIdx = 0; AdjacentIdx < RemainingTriangles[Vertex]; AdjacentIdx++)
+			{
+				if (TriangleScores[Triangles[AdjacentIdx]] > BestScore)
+				{
+					BestScore = TriangleScores[Triangles[AdjacentIdx]];
+					BestTriangle = Triangles[AdjacentIdx];
+				}
+			}
+		}
+
+		if (BestTriangle == -1)
+		{
+			while (NextTriangle < TriangleCount && TriangleAdded[NextTriangle])
+				NextTriangle++;
+
+			if (NextTriangle < TriangleCount)
+				BestTriangle = NextTriangle;
+		}
+	}
+
+	std::copy(SortedIndices.begin(), SortedIndices.end(), Indices);
+}
+
+template<typename IndexType>
+int lcGetVertexCacheMisses(const IndexType* Indices, int IndexCount, int VertexCount, int CacheSize)
+{
+	std::vector<int> CacheTimestamps(VertexCount, -CacheSize - 1);
+	int Misses = 0;
+
+	for (int IndexIdx = 0; IndexIdx < IndexCount; IndexIdx++)
+	{
+		const IndexType Vertex = Indices[IndexIdx];
+
+		// A vertex is still in the FIFO if fewer than CacheSize misses happened since it was added.
+		if (Misses - CacheTimestamps[Vertex] > CacheSize)
+		{
+			CacheTimestamps[Vertex] = Misses;
+			Misses++;
+		}
+	}
+
+	return Misses;
+}
+
+template void lcOptimizeVertexCache<quint16>(quint16* Indices, int IndexCount, int VertexCount);
+template void lcOptimizeVertexCache<quint32>(quint32* Indices, int IndexCount, int VertexCount);
+template int lcGetVertexCacheMisses<quint16>(const quint16* Indices, int IndexCount, int VertexCount, int CacheSize);
+template int lcGetVertexCacheMisses<quint32>(const quint32* Indices, int IndexCount, int VertexCount, int CacheSize);
@@ -0,0 +1,13 @@
+#pragma once
+
+#define LC_VERTEX_CACHE_SIZE 32
+#define LC_VERTEX_CACHE_FIFO_SIZE 16
+
+// Reorders the triangles of an indexed triangle list so vertices are reused while they are still in the
+// post-transform cache, using Tom Forsyth's linear-speed vertex cache optimization.
+template<typename IndexType>
+void lcOptimizeVertexCache(IndexType* Indices, int IndexCount, int VertexCount);
+
+// Returns the number of cache misses when drawing the triangle list through a FIFO cache of the given size.
+template<typename IndexType>
+int lcGetVertexCacheMisses(const IndexType* Indices, int IndexCount, int VertexCount, int CacheSize);
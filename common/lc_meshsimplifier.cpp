@@ -0,0 +1,271 @@
+#include "lc_global.h"
+#include "lc_meshsimplifier.h"
+#include <queue>
+#include <unordered_map>
+
+void lcMeshSimplifier::lcQuadric::AddPlane(const lcVector3& Normal, float Distance)
+{
+	a2 += Normal.x * Normal.x;
+	ab += Normal.x * Normal.y;
+	ac += Normal.x * Normal.z;
+	ad += Normal.x * Distance;
+	b2 += Normal.y * Normal.y;
+	bc += Normal.y * Normal.z;
+	bd += Normal.y * Distance;
+	c2 += Normal.z * Normal.z;
+	cd += Normal.z * Distance;
+	d2 += Distance * Distance;
+}
+
+lcMeshSimplifier::lcQuadric& lcMeshSimplifier::lcQuadric::operator+=(const lcQuadric& Other)
+{
+	a2 += Other.a2;
+	ab += Other.ab;
+	ac += Other.ac;
+	ad += Other.ad;
+	b2 += Other.b2;
+	bc += Other.bc;
+	bd += Other.bd;
+	c2 += Other.c2;
+	cd += Other.cd;
+	d2 += Other.d2;
+
+	return *this;
+}
+
+double lcMeshSimplifier::lcQuadric::Evaluate(const lcVector3& Position) const
+{
+	const double x = Position.x, y = Position.y, z = Position.z;
+
+	return a2 * x * x + 2.0 * ab * x * y + 2.0 * ac * x * z + 2.0 * ad * x + b2 * y * y + 2.0 * bc * y * z + 2.0 * bd * y + c2 * z * z + 2.0 * cd * z + d2;
+}
+
+lcMeshSimplifier::lcMeshSimplifier(std::vector<lcVector3>&& Positions)
+	: mPositions(std::move(Positions))
+{
+	mLocked.resize(mPositions.size(), false);
+}
+
+std::vector<quint32> lcMeshSimplifier::Simplify(const quint32* Indices, size_t IndexCount, size_t TargetTriangleCount, double MaxError) const
+{
+	const size_t TriangleCount = IndexCount / 3;
+	std::vector<quint32> Triangles(Indices, Indices + TriangleCount * 3);
+	std::vector<bool> RemovedTriangles(TriangleCount, false);
+	size_t LiveTriangleCount = TriangleCount;
+
+	// Work on the vertices used by this section only, the triangles are remapped to compact indices and back at the end.
+	std::vector<quint32> SectionVertices(Triangles);
+	std::sort(SectionVertices.begin(), SectionVertices.end());
+	SectionVertices.erase(std::unique(SectionVertices.begin(), SectionVertices.end()), SectionVertices.end());
+
+	for (quint32& Index : Triangles)
+		Index = static_cast<quint32>(std::lower_bound(SectionVertices.begin(), SectionVertices.end(), Index) - SectionVertices.begin());
+
+	const size_t VertexCount = SectionVertices.size();
+	std::vector<lcVector3> Positions(VertexCount);
+	std::vector<bool> Locked(VertexCount);
+
+	for (size_t VertexIdx = 0; VertexIdx < VertexCount; VertexIdx++)
+	{
+		Positions[VertexIdx] = mPositions[SectionVertices[VertexIdx]];
+		Locked[VertexIdx] = mLocked[SectionVertices[VertexIdx]];
+	}
+
+	std::vector<bool> Removed(VertexCount, false);
+	std::vector<quint32> Stamps(VertexCount, 0);
+	std::vector<lcQuadric> Quadrics(VertexCount);
+	std::vector<std::vector<quint32>> VertexTriangles(VertexCount);
+	std::unordered_map<quint64, int> EdgeTriangles;
+
+	EdgeTriangles.reserve(TriangleCount * 2);
+
+	for (size_t TriangleIdx = 0; TriangleIdx < TriangleCount; TriangleIdx++)
+	{
+		const quint32* Triangle = &Triangles[TriangleIdx * 3];
+		const lcVector3& p0 = Positions[Triangle[0]];
+		lcVector3 Normal = lcCross(Positions[Triangle[1]] - p0, Positions[Triangle[2]] - p0);
+		const float Length = lcLength(Normal);
+		lcQuadric Quadric;
+
+		if (Length > 0.0f)
+		{
+			Normal /= Length;
+			Quadric.AddPlane(Normal, -lcDot(Normal, p0));
+		}
+
+		for (int CornerIdx = 0; CornerIdx < 3; CornerIdx++)
+		{
+			const quint32 v0 = Triangle[CornerIdx];
+			const quint32 v1 = Triangle[(CornerIdx + 1) % 3];
+
+			EdgeTriangles[(static_cast<quint64>(qMin(v0, v1)) << 32) | qMax(v0, v1)]++;
+			VertexTriangles[v0].push_back(static_cast<quint32>(TriangleIdx));
+			Quadrics[v0] += Quadric;
+		}
+	}
+
+	// Open edges are the outlines of the section and the seams where the loader split vertices with different normals.
+	for (const auto& EdgeIt : EdgeTriangles)
+	{
+		if (EdgeIt.second != 1)
+			continue;
+
+		Locked[static_cast<quint32>(EdgeIt.first >> 32)] = true;
+		Locked[static_cast<quint32>(EdgeIt.first)] = true;
+	}
+
+	const auto CollapseCompare = [](const lcCollapse& a, const lcCollapse& b)
+	{
+		return a.Cost > b.Cost;
+	};
+
+	std::priority_queue<lcCollapse, std::vector<lcCollapse>, decltype(CollapseCompare)> Collapses(CollapseCompare);
+
+	const auto AddCollapse = [&](quint32 From, quint32 To)
+	{
+		if (Locked[From])
+			return;
+
+		lcQuadric Quadric = Quadrics[From];
+		Quadric += Quadrics[To];
+
+		Collapses.push(lcCollapse{ Quadric.Evaluate(Positions[To]), From, To, Stamps[From], Stamps[To] });
+	};
+
+	for (const auto& EdgeIt : EdgeTriangles)
+	{
+		const quint32 v0 = static_cast<quint32>(EdgeIt.first >> 32);
+		const quint32 v1 = static_cast<quint32>(EdgeIt.first);
+
+		AddCollapse(v0, v1);
+		AddCollapse(v1, v0);
+	}
+
+	while (LiveTriangleCount > TargetTriangleCount && !Collapses.empty())
+	{
+		const lcCollapse Collapse = Collapses.top();
+		Collapses.pop();
+
+		if (Collapse.Cost > MaxError)
+			break;
+
+		const quint32 From = Collapse.From, To = Collapse.To;
+
+		if (Removed[From] || Removed[To] || Stamps[From] != Collapse.FromStamp || Stamps[To] != Collapse.ToStamp)
+			continue;
+
+		// Only collapse edges whose endpoints share no neighbors other than the ones across the edge triangles,
+		// anything else would fold the surface onto itself.
+		const auto GetNeighbors = [&](quint32 Vertex, std::vector<quint32>& Neighbors)
+		{
+			for (quint32 TriangleIdx : VertexTriangles[Vertex])
+				if (!RemovedTriangles[TriangleIdx])
+					for (int CornerIdx = 0; CornerIdx < 3; CornerIdx++)
+						if (Triangles[TriangleIdx * 3 + CornerIdx] != Vertex)
+							Neighbors.push_back(Triangles[TriangleIdx * 3 + CornerIdx]);
+
+			std::sort(Neighbors.begin(), Neighbors.end());
+			Neighbors.erase(std::unique(Neighbors.begin(), Neighbors.end()), Neighbors.end());
+		};
+
+		std::vector<quint32> FromNeighbors, ToNeighbors, SharedNeighbors;
+		GetNeighbors(From, FromNeighbors);
+		GetNeighbors(To, ToNeighbors);
+		std::set_intersection(FromNeighbors.begin(), FromNeighbors.end(), ToNeighbors.begin(), ToNeighbors.end(), std::back_inserter(SharedNeighbors));
+
+		size_t EdgeTriangleCount = 0;
+
+		for (quint32 TriangleIdx : VertexTriangles[From])
+		{
+			const quint32* Triangle = &Triangles[TriangleIdx * 3];
+
+			if (!RemovedTriangles[TriangleIdx] && (Triangle[0] == To || Triangle[1] == To || Triangle[2] == To))
+				EdgeTriangleCount++;
+		}
+
+		if (SharedNeighbors.size() != EdgeTriangleCount)
+			continue;
+
+		bool Flipped = false;
+
+		for (quint32 TriangleIdx : VertexTriangles[From])
+		{
+			const quint32* Triangle = &Triangles[TriangleIdx * 3];
+
+			if (RemovedTriangles[TriangleIdx] || Triangle[0] == To || Triangle[1] == To || Triangle[2] == To)
+				continue;
+
+			lcVector3 Points[3];
+
+			for (int CornerIdx = 0; CornerIdx < 3; CornerIdx++)
+				Points[CornerIdx] = Positions[Triangle[CornerIdx]];
+
+			const lcVector3 OldNormal = lcCross(Points[1] - Points[0], Points[2] - Points[0]);
+
+			for (int CornerIdx = 0; CornerIdx < 3; CornerIdx++)
+				if (Triangle[CornerIdx] == From)
+					Points[CornerIdx] = Positions[To];
+
+			if (lcDot(OldNormal, lcCross(Points[1] - Points[0], Points[2] - Points[0])) <= 0.0f)
+			{
+				Flipped = true;
+				break;
+			}
+		}
+
+		if (Flipped)
+			continue;
+
+		for (quint32 TriangleIdx : VertexTriangles[From])
+		{
+			quint32* Triangle = &Triangles[TriangleIdx * 3];
+
+			if (RemovedTriangles[TriangleIdx])
+				continue;
+
+			if (Triangle[0] == To || Triangle[1] == To || Triangle[2] == To)
+			{
+				RemovedTriangles[TriangleIdx] = true;
+				LiveTriangleCount--;
+				continue;
+			}
+
+			for (int CornerIdx = 0; CornerIdx < 3; CornerIdx++)
+				if (Triangle[CornerIdx] == From)
+					Triangle[CornerIdx] = To;
+
+			VertexTriangles[To].push_back(TriangleIdx);
+		}
+
+		Removed[From] = true;
+		Quadrics[To] += Quadrics[From];
+		Stamps[To]++;
+
+		for (quint32 TriangleIdx : VertexTriangles[To])
+		{
+			if (RemovedTriangles[TriangleIdx])
+				continue;
+
+			for (int CornerIdx = 0; CornerIdx < 3; CornerIdx++)
+			{
+				const quint32 Neighbor = Triangles[TriangleIdx * 3 + CornerIdx];
+
+				if (Neighbor == To)
+					continue;
+
+				AddCollapse(To, Neighbor);
+				AddCollapse(Neighbor, To);
+			}
+		}
+	}
+
+	std::vector<quint32> Result;
+	Result.reserve(LiveTriangleCount * 3);
+
+	for (size_t TriangleIdx = 0; TriangleIdx < TriangleCount; TriangleIdx++)
+		if (!RemovedTriangles[TriangleIdx])
+			for (int CornerIdx = 0; CornerIdx < 3; CornerIdx++)
+				Result.push_back(SectionVertices[Triangles[TriangleIdx * 3 + CornerIdx]]);
+
+	return Result;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "lc_math.h"
+
+// Reduces indexed triangle lists with quadric error edge collapses.
+// Vertices are only collapsed onto their neighbors so the results still index the original vertex array,
+// locked vertices and the vertices of open edges never move.
+class lcMeshSimplifier
+{
+public:
+	explicit lcMeshSimplifier(std::vector<lcVector3>&& Positions);
+
+	void LockVertex(quint32 VertexIndex)
+	{
+		mLocked[VertexIndex] = true;
+	}
+
+	std::vector<quint32> Simplify(const quint32* Indices, size_t IndexCount, size_t TargetTriangleCount, double MaxError) const;
+
+protected:
+	struct lcQuadric
+	{
+		double a2 = 0.0, ab = 0.0, ac = 0.0, ad = 0.0;
+		double b2 = 0.0, bc = 0.0, bd = 0.0;
+		double c2 = 0.0, cd = 0.0;
+		double d2 = 0.0;
+
+		void AddPlane(const lcVector3& Normal, float Distance);
+		lcQuadric& operator+=(const lcQuadric& Other);
+		double Evaluate(const lcVector3& Position) const;
+	};
+
+	struct lcCollapse
+	{
+		double Cost;
+		quint32 From;
+		quint32 To;
+		quint32 FromStamp;
+		quint32 ToStamp;
+	};
+
+	std::vector<lcVector3> mPositions;
+	std::vector<bool> mLocked;
+};
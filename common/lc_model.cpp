@@ -227,6 +227,14 @@ void lcModel::UpdateAllViews() const
 	lcView::UpdateProjectViews(mProject);
 }
 
+void lcModel::UpdateCameraViews(const lcCamera* Camera) const
+{
+	if (Camera->IsSimple())
+		lcView::UpdateCameraViews(Camera);
+	else
+		UpdateAllViews();
+}
+
 void lcModel::UpdatePieceInfo(std::vector<lcModel*>& UpdatedModels)
 {
 	if (std::find(UpdatedModels.begin(), UpdatedModels.end(), this) != UpdatedModels.end())
@@ -688,7 +696,7 @@ void lcModel::LoadLDraw(QIODevice& Device, Project* Project)
 	mCurrentStep = CurrentStep;
 	CalculateStep(mCurrentStep);
 	Library->WaitForLoadQueue();
-	Library->mBuffersDirty = true;
+	Library->mBuffersDirty.storeRelease(1);
 	Library->UnloadUnusedParts();
 
 	delete Piece;
@@ -963,7 +971,7 @@ bool lcModel::LoadLDD(const QString& FileData)
 	lcPiecesLibrary* Library = lcGetPiecesLibrary();
 	CalculateStep(mCurrentStep);
 	Library->WaitForLoadQueue();
-	Library->mBuffersDirty = true;
+	Library->mBuffersDirty.storeRelease(1);
 	Library->UnloadUnusedParts();
 
 	return true;
@@ -1005,7 +1013,7 @@ bool lcModel::LoadInventory(const QByteArray& Inventory)
 		return false;
 
 	Library->WaitForLoadQueue();
-	Library->mBuffersDirty = true;
+	Library->mBuffersDirty.storeRelease(1);
 	Library->UnloadUnusedParts();
 
 	auto RoundBounds = [](float& Value)
@@ -2228,7 +2236,7 @@ void lcModel::InsertPiece(lcPiece* Piece, int Index)
 		const lcMesh* Mesh = Info->GetMesh();
 
 		if (Mesh && Mesh->mVertexCacheOffset == -1)
-			lcGetPiecesLibrary()->mBuffersDirty = true;
+			lcGetPiecesLibrary()->mBuffersDirty.storeRelease(1);
 	}
 
 	mPieces.InsertAt(Index, Piece);
@@ -4208,14 +4216,14 @@ void lcModel::UpdateZoomTool(lcCamera* Camera, float Mouse)
 	Camera->Zoom(Mouse - mMouseToolDistance.x, mCurrentStep, gMainWindow->GetAddKeys());
 	mMouseToolDistance.x = Mouse;
 
-	UpdateAllViews();
+	UpdateCameraViews(Camera);
 }
 
 void lcModel::UpdatePanTool(lcCamera* Camera, const lcVector3& Distance)
 {
 	Camera->Pan(Distance, mCurrentStep, gMainWindow->GetAddKeys());
 
-	UpdateAllViews();
+	UpdateCameraViews(Camera);
 }
 
 void lcModel::UpdateOrbitTool(lcCamera* Camera, float MouseX, float MouseY)
@@ -4227,7 +4235,7 @@ void lcModel::UpdateOrbitTool(lcCamera* Camera, float MouseX, float MouseY)
 	mMouseToolDistance.x = MouseX;
 	mMouseToolDistance.y = MouseY;
 
-	UpdateAllViews();
+	UpdateCameraViews(Camera);
 }
 
 void lcModel::UpdateRollTool(lcCamera* Camera, float Mouse)
@@ -4235,7 +4243,7 @@ void lcModel::UpdateRollTool(lcCamera* Camera, float Mouse)
 	Camera->Roll(Mouse - mMouseToolDistance.x, mCurrentStep, gMainWindow->GetAddKeys());
 	mMouseToolDistance.x = Mouse;
 
-	UpdateAllViews();
+	UpdateCameraViews(Camera);
 }
 
 void lcModel::ZoomRegionToolClicked(lcCamera* Camera, float AspectRatio, const lcVector3& Position, const lcVector3& TargetPosition, const lcVector3* Corners)
@@ -4243,7 +4251,7 @@ void lcModel::ZoomRegionToolClicked(lcCamera* Camera, float AspectRatio, const l
 	Camera->ZoomRegion(AspectRatio, Position, TargetPosition, Corners, mCurrentStep, gMainWindow->GetAddKeys());
 
 	gMainWindow->UpdateSelectedObjects(false);
-	UpdateAllViews();
+	UpdateCameraViews(Camera);
 
 	if (!Camera->IsSimple())
 		SaveCheckpoint(tr("Zoom"));
@@ -4266,7 +4274,7 @@ void lcModel::LookAt(lcCamera* Camera)
 	Camera->Center(Center, mCurrentStep, gMainWindow->GetAddKeys());
 
 	gMainWindow->UpdateSelectedObjects(false);
-	UpdateAllViews();
+	UpdateCameraViews(Camera);
 
 	if (!Camera->IsSimple())
 		SaveCheckpoint(tr("Look At"));
@@ -4276,7 +4284,7 @@ void lcModel::MoveCamera(lcCamera* Camera, const lcVector3& Direction)
 {
 	Camera->MoveRelative(Direction, mCurrentStep, gMainWindow->GetAddKeys());
 	gMainWindow->UpdateSelectedObjects(false);
-	UpdateAllViews();
+	UpdateCameraViews(Camera);
 
 	if (!Camera->IsSimple())
 		SaveCheckpoint(tr("Moving Camera"));
@@ -4303,7 +4311,7 @@ void lcModel::ZoomExtents(lcCamera* Camera, float Aspect)
 
 	if (!mIsPreview && gMainWindow)
 		gMainWindow->UpdateSelectedObjects(false);
-	UpdateAllViews();
+	UpdateCameraViews(Camera);
 
 	if (!Camera->IsSimple())
 		SaveCheckpoint(tr("Zoom"));
@@ -4315,7 +4323,7 @@ void lcModel::Zoom(lcCamera* Camera, float Amount)
 
 	if (!mIsPreview)
 		gMainWindow->UpdateSelectedObjects(false);
-	UpdateAllViews();
+	UpdateCameraViews(Camera);
 
 	if (!Camera->IsSimple())
 		SaveCheckpoint(tr("Zoom"));
@@ -105,6 +105,7 @@ public:
 	void UpdatePieceInfo(std::vector<lcModel*>& UpdatedModels);
 	void UpdateMesh();
 	void UpdateAllViews() const;
+	void UpdateCameraViews(const lcCamera* Camera) const;
 
 	PieceInfo* GetPieceInfo() const
 	{
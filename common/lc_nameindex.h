@@ -0,0 +1,241 @@
+#pragma once
+
+#define LC_NAME_POOL_BLOCK_SIZE (64 * 1024)
+
+// Case insensitive name to pointer index used by the library lookups.
+// Names are folded to upper case with '/' separators and interned once, lookups don't lock or allocate
+// and can run while another thread adds entries. Removed entries keep their name with a null value.
+template<typename T>
+class lcNameIndex
+{
+public:
+	lcNameIndex()
+	{
+	}
+
+	~lcNameIndex()
+	{
+		delete mTable.loadAcquire();
+	}
+
+	lcNameIndex(const lcNameIndex&) = delete;
+	lcNameIndex(lcNameIndex&&) = delete;
+	lcNameIndex& operator=(const lcNameIndex&) = delete;
+	lcNameIndex& operator=(lcNameIndex&&) = delete;
+
+	T* Find(const char* Name) const
+	{
+		const lcNameIndexTable* Table = mTable.loadAcquire();
+
+		if (!Table)
+			return nullptr;
+
+		const quint32 Hash = GetHash(Name);
+
+		for (quint32 EntryIdx = Hash & Table->Mask; ; EntryIdx = (EntryIdx + 1) & Table->Mask)
+		{
+			const lcNameIndexEntry& Entry = Table->Entries[EntryIdx];
+			const char* EntryName = Entry.Name.loadAcquire();
+
+			if (!EntryName)
+				return nullptr;
+
+			if (Entry.Hash == Hash && IsFoldedEqual(EntryName, Name))
+				return Entry.Value.loadAcquire();
+		}
+	}
+
+	void Insert(const char* Name, T* Value)
+	{
+		QMutexLocker Lock(&mMutex);
+
+		lcNameIndexTable* Table = mTable.loadAcquire();
+
+		if (!Table || (mCount + 1) * 4 > (Table->Mask + 1) * 3)
+			Table = Grow();
+
+		const quint32 Hash = GetHash(Name);
+
+		for (quint32 EntryIdx = Hash & Table->Mask; ; EntryIdx = (EntryIdx + 1) & Table->Mask)
+		{
+			lcNameIndexEntry& Entry = Table->Entries[EntryIdx];
+			const char* EntryName = Entry.Name.loadAcquire();
+
+			if (!EntryName)
+			{
+				Entry.Hash = Hash;
+				Entry.Value.storeRelease(Value);
+				Entry.Name.storeRelease(InternName(Name));
+				mCount++;
+				return;
+			}
+
+			if (Entry.Hash == Hash && IsFoldedEqual(EntryName, Name))
+			{
+				Entry.Value.storeRelease(Value);
+				return;
+			}
+		}
+	}
+
+	void Remove(const char* Name)
+	{
+		QMutexLocker Lock(&mMutex);
+
+		lcNameIndexTable* Table = mTable.loadAcquire();
+
+		if (!Table)
+			return;
+
+		const quint32 Hash = GetHash(Name);
+
+		for (quint32 EntryIdx = Hash & Table->Mask; ; EntryIdx = (EntryIdx + 1) & Table->Mask)
+		{
+			lcNameIndexEntry& Entry = Table->Entries[EntryIdx];
+			const char* EntryName = Entry.Name.loadAcquire();
+
+			if (!EntryName)
+				return;
+
+			if (Entry.Hash == Hash && IsFoldedEqual(EntryName, Name))
+			{
+				Entry.Value.storeRelease(nullptr);
+				return;
+			}
+		}
+	}
+
+	// Not safe to call while other threads are reading.
+	void Clear()
+	{
+		QMutexLocker Lock(&mMutex);
+
+		delete mTable.fetchAndStoreAcquire(nullptr);
+		mRetiredTables.clear();
+		mNamePool.clear();
+		mNamePoolUsed = 0;
+		mCount = 0;
+	}
+
+	static char FoldChar(char c)
+	{
+		if (c >= 'a' && c <= 'z')
+			return c + 'A' - 'a';
+		else if (c == '\\')
+			return '/';
+
+		return c;
+	}
+
+protected:
+	struct lcNameIndexEntry
+	{
+		quint32 Hash = 0;
+		QAtomicPointer<const char> Name;
+		QAtomicPointer<T> Value;
+	};
+
+	struct lcNameIndexTable
+	{
+		explicit lcNameIndexTable(quint32 Size)
+			: Mask(Size - 1), Entries(new lcNameIndexEntry[Size])
+		{
+		}
+
+		quint32 Mask;
+		std::unique_ptr<lcNameIndexEntry[]> Entries;
+	};
+
+	static quint32 GetHash(const char* Name)
+	{
+		quint32 Hash = 2166136261u;
+
+		for (; *Name; Name++)
+			Hash = (Hash ^ static_cast<unsigned char>(FoldChar(*Name))) * 16777619u;
+
+		return Hash;
+	}
+
+	static bool IsFoldedEqual(const char* FoldedName, const char* Name)
+	{
+		for (; *FoldedName; FoldedName++, Name++)
+			if (*FoldedName != FoldChar(*Name))
+				return false;
+
+		return !*Name;
+	}
+
+	const char* InternName(const char* Name)
+	{
+		const size_t Length = strlen(Name) + 1;
+
+		if (mNamePool.empty() || mNamePoolUsed + Length > LC_NAME_POOL_BLOCK_SIZE)
+		{
+			mNamePool.emplace_back(new char[qMax(Length, static_cast<size_t>(LC_NAME_POOL_BLOCK_SIZE))]);
+			mNamePoolUsed = 0;
+		}
+
+		char* Interned = mNamePool.back().get() + mNamePoolUsed;
+		mNamePoolUsed += Length;
+
+		for (size_t CharIdx = 0; CharIdx < Length; CharIdx++)
+			Interned[CharIdx] = FoldChar(Name[CharIdx]);
+
+		return Interned;
+	}
+
+	lcNameIndexTable* Grow()
+	{
+		lcNameIndexTable* OldTable = mTable.loadAcquire();
+		quint32 Size = OldTable ? (OldTable->Mask + 1) * 2 : 1024;
+		mCount = 0;
+
+		if (OldTable)
+		{
+			for (quint32 EntryIdx = 0; EntryIdx <= OldTable->Mask; EntryIdx++)
+				if (OldTable->Entries[EntryIdx].Value.loadAcquire())
+					mCount++;
+
+			while ((mCount + 1) * 4 > Size * 3)
+				Size *= 2;
+		}
+
+		lcNameIndexTable* NewTable = new lcNameIndexTable(Size);
+
+		if (OldTable)
+		{
+			for (quint32 OldIdx = 0; OldIdx <= OldTable->Mask; OldIdx++)
+			{
+				const lcNameIndexEntry& OldEntry = OldTable->Entries[OldIdx];
+				T* Value = OldEntry.Value.loadAcquire();
+
+				if (!Value)
+					continue;
+
+				quint32 EntryIdx = OldEntry.Hash & NewTable->Mask;
+
+				while (NewTable->Entries[EntryIdx].Name.loadAcquire())
+					EntryIdx = (EntryIdx + 1) & NewTable->Mask;
+
+				lcNameIndexEntry& Entry = NewTable->Entries[EntryIdx];
+				Entry.Hash = OldEntry.Hash;
+				Entry.Value.storeRelease(Value);
+				Entry.Name.storeRelease(OldEntry.Name.loadAcquire());
+			}
+
+			// Readers may still be probing the old table so it is kept alive until Clear().
+			mRetiredTables.emplace_back(OldTable);
+		}
+
+		mTable.storeRelease(NewTable);
+
+		return NewTable;
+	}
+
+	QAtomicPointer<lcNameIndexTable> mTable;
+	std::vector<std::unique_ptr<lcNameIndexTable>> mRetiredTables;
+	std::vector<std::unique_ptr<char[]>> mNamePool;
+	size_t mNamePoolUsed = 0;
+	quint32 mCount = 0;
+	QMutex mMutex;
+};
@@ -64,6 +64,7 @@ lcPartSelectionListModel::lcPartSelectionListModel(QObject* Parent)
 	}
 
 	connect(lcGetPiecesLibrary(), &lcPiecesLibrary::PartLoaded, this, &lcPartSelectionListModel::PartLoaded);
+	connect(lcGetPiecesLibrary(), &lcPiecesLibrary::BatchLoaded, this, &lcPartSelectionListModel::BatchLoaded);
 }
 
 lcPartSelectionListModel::~lcPartSelectionListModel()
@@ -457,6 +458,22 @@ void lcPartSelectionListModel::PartLoaded(PieceInfo* Info)
 	}
 }
 
+void lcPartSelectionListModel::BatchLoaded()
+{
+	for (auto PreviewIt = mRequestedPreviews.begin(); PreviewIt != mRequestedPreviews.end();)
+	{
+		const int InfoIndex = *PreviewIt;
+
+		if (mParts[InfoIndex].first->mState == lcPieceInfoState::Loaded)
+		{
+			PreviewIt = mRequestedPreviews.erase(PreviewIt);
+			DrawPreview(InfoIndex);
+		}
+		else
+			PreviewIt++;
+	}
+}
+
 void lcPartSelectionListModel::DrawPreview(int InfoIndex)
 {
 	const int Width = mIconSize * 2;
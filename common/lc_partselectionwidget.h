@@ -122,6 +122,7 @@ public:
 
 protected slots:
 	void PartLoaded(PieceInfo* Info);
+	void BatchLoaded();
 
 protected:
 	void ClearRequests();
@@ -129,6 +129,9 @@ static lcProfileEntry gProfileEntries[LC_NUM_PROFILE_KEYS] =
 	lcProfileEntry("Settings", "PartsListAliases", 1),                                         // LC_PROFILE_PARTS_LIST_ALIASES
 	lcProfileEntry("Settings", "PartsListListMode", 0),                                        // LC_PROFILE_PARTS_LIST_LISTMODE
 	lcProfileEntry("Settings", "StudStyle", 0),                                                // LC_PROFILE_STUD_STYLE
+	lcProfileEntry("Settings", "PartMemoryBudget", 0),                                         // LC_PROFILE_PART_MEMORY_BUDGET
+	lcProfileEntry("Settings", "InstanceStuds", 0),                                            // LC_PROFILE_INSTANCE_STUDS
+	lcProfileEntry("Settings", "CompactVertices", 0),                                          // LC_PROFILE_COMPACT_VERTICES
 
 	lcProfileEntry("Defaults", "Author", ""),                                                  // LC_PROFILE_DEFAULT_AUTHOR_NAME
 	lcProfileEntry("Defaults", "AmbientColor", LC_RGB(75, 75, 75)),                            // LC_PROFILE_DEFAULT_AMBIENT_COLOR
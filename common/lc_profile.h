@@ -76,6 +76,9 @@ enum LC_PROFILE_KEY
 	LC_PROFILE_PARTS_LIST_ALIASES,
 	LC_PROFILE_PARTS_LIST_LISTMODE,
 	LC_PROFILE_STUD_STYLE,
+	LC_PROFILE_PART_MEMORY_BUDGET,
+	LC_PROFILE_INSTANCE_STUDS,
+	LC_PROFILE_COMPACT_VERTICES,
 
 	// Defaults for new projects.
 	LC_PROFILE_DEFAULT_AUTHOR_NAME,
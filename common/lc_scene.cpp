@@ -6,63 +6,225 @@
 #include "lc_library.h"
 #include "lc_application.h"
 #include "object.h"
+#include "lc_glextensions.h"
+
+#define LC_SCENE_MIN_INSTANCES 4
+
+// Stable LSD radix sort of Values by Keys, one byte per pass.
+template<typename KeyType, typename ValueType>
+static void lcRadixSort(KeyType* Keys, ValueType* Values, int Count, std::vector<KeyType>& KeyBuffer, std::vector<ValueType>& ValueBuffer)
+{
+	if (Count < 2)
+		return;
+
+	constexpr int DigitCount = sizeof(KeyType);
+	int Histograms[DigitCount][256] = {};
+
+	for (int Idx = 0; Idx < Count; Idx++)
+		for (int Digit = 0; Digit < DigitCount; Digit++)
+			Histograms[Digit][(Keys[Idx] >> (Digit * 8)) & 0xff]++;
+
+	KeyBuffer.resize(Count);
+	ValueBuffer.resize(Count);
+
+	KeyType* SrcKeys = Keys;
+	KeyType* DstKeys = KeyBuffer.data();
+	ValueType* SrcValues = Values;
+	ValueType* DstValues = ValueBuffer.data();
+
+	for (int Digit = 0; Digit < DigitCount; Digit++)
+	{
+		int* Histogram = Histograms[Digit];
+		const int Shift = Digit * 8;
+
+		// Skip bytes that are the same in every key, such as the high bytes of mesh addresses.
+		if (Histogram[(SrcKeys[0] >> Shift) & 0xff] == Count)
+			continue;
+
+		for (int Bucket = 0, Offset = 0; Bucket < 256; Bucket++)
+		{
+			const int BucketCount = Histogram[Bucket];
+			Histogram[Bucket] = Offset;
+			Offset += BucketCount;
+		}
+
+		for (int Idx = 0; Idx < Count; Idx++)
+		{
+			const int DstIdx = Histogram[(SrcKeys[Idx] >> Shift) & 0xff]++;
+			DstKeys[DstIdx] = SrcKeys[Idx];
+			DstValues[DstIdx] = SrcValues[Idx];
+		}
+
+		std::swap(SrcKeys, DstKeys);
+		std::swap(SrcValues, DstValues);
+	}
+
+	if (SrcKeys != Keys)
+	{
+		std::copy(SrcKeys, SrcKeys + Count, Keys);
+		std::copy(SrcValues, SrcValues + Count, Values);
+	}
+}
+
+static quint64 lcGetOpaqueSortKey(const lcMesh* Mesh)
+{
+	// Untextured meshes are drawn first, then copies of the same mesh are kept together ordered by address.
+	const quint64 TextureKey = (Mesh->mFlags & lcMeshFlag::HasTexture) ? 1ULL << 63 : 0;
+
+	return TextureKey | (static_cast<quint64>(reinterpret_cast<quintptr>(Mesh)) >> 1);
+}
+
+static quint32 lcGetTranslucentSortKey(float Distance)
+{
+	// Distances are never negative so their bit patterns sort like the values, invert them to draw back to front.
+	quint32 Bits;
+	memcpy(&Bits, &Distance, sizeof(Bits));
+
+	return ~Bits;
+}
+
+static bool lcIsMeshInFrustum(const lcMesh* Mesh, const lcMatrix44& WorldMatrix, const lcVector4 (&Planes)[6])
+{
+	const lcVector3 Center = lcMul31((Mesh->mBoundingBox.Min + Mesh->mBoundingBox.Max) * 0.5f, WorldMatrix);
+	const float Scale = sqrtf(lcMax(lcMax(lcLengthSquared(lcVector3(WorldMatrix[0])), lcLengthSquared(lcVector3(WorldMatrix[1]))), lcLengthSquared(lcVector3(WorldMatrix[2]))));
+	const float Radius = Mesh->mRadius * Scale;
+
+	for (const lcVector4& Plane : Planes)
+		if (lcDot3(Center, Plane) + Plane[3] > Radius)
+			return false;
+
+	return true;
+}
 
 lcScene::lcScene()
-	: mRenderMeshes(0, 1024), mOpaqueMeshes(0, 1024), mTranslucentMeshes(0, 1024), mInterfaceObjects(0, 1024)
+	: mSceneMeshes(0, 1024), mRenderMeshes(0, 1024), mOpaqueMeshes(0, 1024), mTranslucentMeshes(0, 1024), mInterfaceObjects(0, 1024)
 {
 	mActiveSubmodelInstance = nullptr;
 	mDrawInterface = false;
 	mShadingMode = lcShadingMode::DefaultLights;
 	mAllowLOD = true;
 	mMeshLODDistance = 250.0f;
+	mFrustumCulling = false;
 	mHasFadedParts = false;
 	mPreTranslucentCallback = nullptr;
+	mUseObjectBuffer = false;
+	mSceneCulledMeshes = 0;
+	mStats = lcSceneStats();
 }
 
 void lcScene::Begin(const lcMatrix44& ViewMatrix)
 {
-	mViewMatrix = ViewMatrix;
+	SetViewMatrix(ViewMatrix);
 	mActiveSubmodelInstance = nullptr;
 	mPreTranslucentCallback = nullptr;
+	mSceneMeshes.RemoveAll();
+	mInterfaceObjects.RemoveAll();
+}
+
+void lcScene::SetViewMatrix(const lcMatrix44& ViewMatrix)
+{
+	mViewMatrix = ViewMatrix;
+	mFrustumCulling = false;
+}
+
+void lcScene::SetCullingProjection(const lcMatrix44& ProjectionMatrix)
+{
+	lcGetFrustumPlanes(mViewMatrix, ProjectionMatrix, mFrustumPlanes);
+	mCullingProjection = ProjectionMatrix;
+	mFrustumCulling = true;
+}
+
+// Returns the radius of a sphere on screen as a fraction of half the viewport height, scenes drawn without a
+// culling projection don't know the viewport and report every mesh as large.
+float lcScene::GetProjectedSize(float Radius, float ViewDepth) const
+{
+	if (!mFrustumCulling)
+		return FLT_MAX;
+
+	const float w = fabsf(ViewDepth * mCullingProjection[2][3] + mCullingProjection[3][3]);
+
+	return w > 0.0f ? Radius * mCullingProjection[1][1] / w : FLT_MAX;
+}
+
+// Builds the view dependent render lists from the meshes added since Begin(), a scene whose contents
+// didn't change can call SetViewMatrix() and End() again to only redo the culling, LOD and sorting.
+void lcScene::End()
+{
 	mRenderMeshes.RemoveAll();
 	mOpaqueMeshes.RemoveAll();
+	mOpaqueSortKeys.clear();
 	mTranslucentMeshes.RemoveAll();
-	mInterfaceObjects.RemoveAll();
+	mTranslucentSortKeys.clear();
+	mStats = lcSceneStats();
 
 	const lcPreferences& Preferences = lcGetPreferences();
 	mHighlightColor = lcVector4FromColor(Preferences.mHighlightNewPartsColor);
+	mFocusedColor = lcVector4FromColor(Preferences.mObjectFocusedColor);
+	mSelectedColor = lcVector4FromColor(Preferences.mObjectSelectedColor);
 	mFadeColor = lcVector4FromColor(Preferences.mFadeStepsColor);
 	mHasFadedParts = false;
 	mTranslucentFade = mFadeColor.w != 1.0f;
+
+	for (const lcSceneMesh& SceneMesh : mSceneMeshes)
+		AddSceneMesh(SceneMesh);
+
+	mSceneCulledMeshes = mStats.CulledMeshes;
+
+	lcRadixSort(mOpaqueSortKeys.data(), mOpaqueMeshes.begin(), mOpaqueMeshes.GetSize(), mOpaqueSortKeyBuffer, mOpaqueMeshBuffer);
+	lcRadixSort(mTranslucentSortKeys.data(), mTranslucentMeshes.begin(), mTranslucentMeshes.GetSize(), mTranslucentSortKeyBuffer, mTranslucentMeshBuffer);
 }
 
-void lcScene::End()
+void lcScene::AddMesh(lcMesh* Mesh, const lcMatrix44& WorldMatrix, int ColorIndex, lcRenderMeshState State)
+{
+	lcSceneMesh& SceneMesh = mSceneMeshes.Add();
+
+	SceneMesh.WorldMatrix = WorldMatrix;
+	SceneMesh.Mesh = Mesh;
+	SceneMesh.ColorIndex = ColorIndex;
+	SceneMesh.State = State;
+}
+
+void lcScene::AddSceneMesh(const lcSceneMesh& SceneMesh)
 {
-	const auto OpaqueMeshCompare = [this](int Index1, int Index2)
+	lcMesh* Mesh = SceneMesh.Mesh;
+	const lcMatrix44& WorldMatrix = SceneMesh.WorldMatrix;
+	const int ColorIndex = SceneMesh.ColorIndex;
+	const lcRenderMeshState State = SceneMesh.State;
+
+	if (mFrustumCulling && !lcIsMeshInFrustum(Mesh, WorldMatrix, mFrustumPlanes))
 	{
-		const lcMesh* Mesh1 = mRenderMeshes[Index1].Mesh;
-		const lcMesh* Mesh2 = mRenderMeshes[Index2].Mesh;
+		mStats.CulledMeshes += 1 + static_cast<int>(Mesh->mInstances.size());
+		return;
+	}
 
-		const int Texture1 = Mesh1->mFlags & lcMeshFlag::HasTexture;
-		const int Texture2 = Mesh2->mFlags & lcMeshFlag::HasTexture;
+	const float ViewDepth = lcMul31(WorldMatrix[3], mViewMatrix).z;
+	const float Distance = fabsf(ViewDepth) - mMeshLODDistance;
+	const float ProjectedSize = GetProjectedSize(Mesh->mRadius, ViewDepth);
+	const int LodIndex = mAllowLOD ? Mesh->GetLodIndex(Distance, ProjectedSize) : LC_MESH_LOD_HIGH;
 
-		if (Texture1 == Texture2)
-			return Mesh1 < Mesh2;
+	AddRenderMesh(Mesh, WorldMatrix, ColorIndex, State, LodIndex);
 
-		return Texture1 ? false : true;
-	};
+	if (Mesh->mInstances.empty())
+		return;
 
-	std::sort(mOpaqueMeshes.begin(), mOpaqueMeshes.end(), OpaqueMeshCompare);
+	const bool AllowInstanceLOD = mAllowLOD && Distance > Mesh->mRadius;
 
-	auto TranslucentMeshCompare = [](const lcTranslucentMeshInstance& Mesh1, const lcTranslucentMeshInstance& Mesh2)
+	for (const lcMeshInstance& Instance : Mesh->mInstances)
 	{
-		return Mesh1.Distance > Mesh2.Distance;
-	};
+		const lcMatrix44 InstanceWorldMatrix = lcMul(Instance.Transform, WorldMatrix);
 
-	std::sort(mTranslucentMeshes.begin(), mTranslucentMeshes.end(), TranslucentMeshCompare);
+		if (mFrustumCulling && !lcIsMeshInFrustum(Instance.Mesh.get(), InstanceWorldMatrix, mFrustumPlanes))
+		{
+			mStats.CulledMeshes++;
+			continue;
+		}
+
+		const int InstanceLodIndex = AllowInstanceLOD ? Instance.Mesh->GetLodIndex(Distance, ProjectedSize) : LC_MESH_LOD_HIGH;
+		AddRenderMesh(Instance.Mesh.get(), InstanceWorldMatrix, ColorIndex, State, InstanceLodIndex);
+	}
 }
 
-void lcScene::AddMesh(lcMesh* Mesh, const lcMatrix44& WorldMatrix, int ColorIndex, lcRenderMeshState State)
+void lcScene::AddRenderMesh(lcMesh* Mesh, const lcMatrix44& WorldMatrix, int ColorIndex, lcRenderMeshState State, int LodIndex)
 {
 	lcRenderMesh& RenderMesh = mRenderMeshes.Add();
 
@@ -70,8 +232,7 @@ void lcScene::AddMesh(lcMesh* Mesh, const lcMatrix44& WorldMatrix, int ColorInde
 	RenderMesh.Mesh = Mesh;
 	RenderMesh.ColorIndex = ColorIndex;
 	RenderMesh.State = State;
-	const float Distance = fabsf(lcMul31(WorldMatrix[3], mViewMatrix).z) - mMeshLODDistance;
-	RenderMesh.LodIndex = mAllowLOD ? RenderMesh.Mesh->GetLodIndex(Distance) : LC_MESH_LOD_HIGH;
+	RenderMesh.LodIndex = LodIndex;
 
 	const bool ForceTranslucent = (mTranslucentFade && State == lcRenderMeshState::Faded);
 	const bool Translucent = lcIsColorTranslucent(ColorIndex) || ForceTranslucent;
@@ -79,7 +240,10 @@ void lcScene::AddMesh(lcMesh* Mesh, const lcMatrix44& WorldMatrix, int ColorInde
 	mHasFadedParts |= State == lcRenderMeshState::Faded;
 
 	if ((Flags & (lcMeshFlag::HasSolid | lcMeshFlag::HasLines)) || ((Flags & lcMeshFlag::HasDefault) && !Translucent))
+	{
 		mOpaqueMeshes.Add(mRenderMeshes.GetSize() - 1);
+		mOpaqueSortKeys.push_back(lcGetOpaqueSortKey(Mesh));
+	}
 
 	if ((Flags & lcMeshFlag::HasTranslucent) || ((Flags & lcMeshFlag::HasDefault) && Translucent))
 	{
@@ -107,10 +271,146 @@ void lcScene::AddMesh(lcMesh* Mesh, const lcMatrix44& WorldMatrix, int ColorInde
 			Instance.Section = Section;
 			Instance.Distance = InstanceDistance;
 			Instance.RenderMeshIndex = mRenderMeshes.GetSize() - 1;
+			mTranslucentSortKeys.push_back(lcGetTranslucentSortKey(InstanceDistance));
 		}
 	}
 }
 
+void lcScene::UpdateVisibleMeshes(lcContext* Context) const
+{
+	mVisibleMeshes.assign(mRenderMeshes.GetSize(), true);
+	mMeshFrustumPlanes.resize(mRenderMeshes.GetSize() * 6);
+
+	const lcMatrix44& ProjectionMatrix = Context->GetProjectionMatrix();
+
+	// The scene was culled against the whole view when it was built, tiled renders cull again against the current tile.
+	lcVector4 Planes[6];
+
+	if (mFrustumCulling)
+		lcGetFrustumPlanes(mViewMatrix, ProjectionMatrix, Planes);
+
+	for (int MeshIdx = 0; MeshIdx < mRenderMeshes.GetSize(); MeshIdx++)
+	{
+		const lcRenderMesh& RenderMesh = mRenderMeshes[MeshIdx];
+
+		if (mFrustumCulling && !lcIsMeshInFrustum(RenderMesh.Mesh, RenderMesh.WorldMatrix, Planes))
+		{
+			mVisibleMeshes[MeshIdx] = false;
+			mStats.CulledMeshes++;
+			continue;
+		}
+
+		mStats.DrawnMeshes++;
+
+		// Clusters are culled in object space, every pass drawing a section of this mesh reuses the same planes.
+		if (!RenderMesh.Mesh->mClusters.empty())
+			lcGetFrustumPlanes(lcMul(RenderMesh.WorldMatrix, mViewMatrix), ProjectionMatrix, &mMeshFrustumPlanes[MeshIdx * 6]);
+	}
+}
+
+void lcScene::UpdateObjectData(lcContext* Context) const
+{
+	mUseObjectBuffer = false;
+
+	if (!gSupportsObjectBuffer)
+		return;
+
+	size_t ObjectDataSize = 0;
+
+	for (const int MeshIndex : mOpaqueMeshes)
+		if (mVisibleMeshes[MeshIndex])
+			ObjectDataSize += 4 + mRenderMeshes[MeshIndex].Mesh->mLods[mRenderMeshes[MeshIndex].LodIndex].NumSections;
+
+	// Texture buffers are only guaranteed to hold 65536 texels, frames that need more set the colors one section at a time.
+	if (ObjectDataSize > static_cast<size_t>(Context->GetMaxObjectDataSize()))
+		return;
+
+	mUseObjectBuffer = true;
+	mObjectOffsets.resize(mRenderMeshes.GetSize());
+	Context->ClearObjectData();
+
+	// Each visible opaque mesh stores its world matrix followed by the color of every section.
+	for (const int MeshIndex : mOpaqueMeshes)
+	{
+		if (!mVisibleMeshes[MeshIndex])
+			continue;
+
+		const lcRenderMesh& RenderMesh = mRenderMeshes[MeshIndex];
+		const lcMesh* Mesh = RenderMesh.Mesh;
+		const lcMeshLod& Lod = Mesh->mLods[RenderMesh.LodIndex];
+
+		mObjectOffsets[MeshIndex] = Context->AddObjectMatrix(Mesh->mCompactVertices ? lcMul(Mesh->mDequantizeMatrix, RenderMesh.WorldMatrix) : RenderMesh.WorldMatrix);
+
+		for (int SectionIdx = 0; SectionIdx < Lod.NumSections; SectionIdx++)
+		{
+			lcVector4 Color(0.0f, 0.0f, 0.0f, 0.0f);
+			GetOpaqueSectionColor(RenderMesh, &Lod.Sections[SectionIdx], Color);
+			Context->AddObjectColor(Color);
+		}
+	}
+
+	Context->UploadObjectData();
+}
+
+void lcScene::DrawSection(lcContext* Context, const lcRenderMesh& RenderMesh, const lcMeshSection* Section, int IndexBufferOffset, const lcVector4* Planes) const
+{
+	const lcMesh* Mesh = RenderMesh.Mesh;
+	const GLenum DrawPrimitiveType = Section->PrimitiveType & (LC_MESH_TRIANGLES | LC_MESH_TEXTURED_TRIANGLES) ? GL_TRIANGLES : GL_LINES;
+
+	if (!Section->NumClusters)
+	{
+		Context->DrawIndexedPrimitives(DrawPrimitiveType, Section->NumIndices, Mesh->mIndexType, IndexBufferOffset + Section->IndexOffset);
+		mStats.DrawCalls++;
+		return;
+	}
+
+	const lcMeshCluster* Clusters = &Mesh->mClusters[Section->FirstCluster];
+	int DrawOffset = -1, DrawCount = 0;
+
+	// Clusters are stored back to back in the index buffer so visible neighbors are merged into a single draw call.
+	for (int ClusterIdx = 0; ClusterIdx < Section->NumClusters; ClusterIdx++)
+	{
+		const lcMeshCluster& Cluster = Clusters[ClusterIdx];
+		bool Visible = true;
+
+		for (int PlaneIdx = 0; PlaneIdx < 6; PlaneIdx++)
+		{
+			const lcVector4& Plane = Planes[PlaneIdx];
+
+			if (lcDot3(Cluster.Center, Plane) + Plane[3] > Cluster.Radius)
+			{
+				Visible = false;
+				break;
+			}
+		}
+
+		if (Visible)
+		{
+			if (!DrawCount)
+				DrawOffset = Cluster.IndexOffset;
+
+			DrawCount += Cluster.NumIndices;
+			continue;
+		}
+
+		mStats.CulledClusters++;
+		mStats.CulledTriangles += Cluster.NumIndices / 3;
+
+		if (DrawCount)
+		{
+			Context->DrawIndexedPrimitives(DrawPrimitiveType, DrawCount, Mesh->mIndexType, IndexBufferOffset + DrawOffset);
+			mStats.DrawCalls++;
+			DrawCount = 0;
+		}
+	}
+
+	if (DrawCount)
+	{
+		Context->DrawIndexedPrimitives(DrawPrimitiveType, DrawCount, Mesh->mIndexType, IndexBufferOffset + DrawOffset);
+		mStats.DrawCalls++;
+	}
+}
+
 void lcScene::DrawDebugNormals(lcContext* Context, const lcMesh* Mesh) const
 {
 	const lcVertex* const VertexBuffer = Mesh->GetVertexData();
@@ -135,32 +435,211 @@ void lcScene::DrawDebugNormals(lcContext* Context, const lcMesh* Mesh) const
 	free(Vertices);
 }
 
+bool lcScene::GetOpaqueSectionColor(const lcRenderMesh& RenderMesh, const lcMeshSection* Section, lcVector4& Color) const
+{
+	int ColorIndex = Section->ColorIndex;
+
+	if (Section->PrimitiveType & (LC_MESH_TRIANGLES | LC_MESH_TEXTURED_TRIANGLES))
+	{
+		if (ColorIndex == gDefaultColor)
+			ColorIndex = RenderMesh.ColorIndex;
+
+		if (lcIsColorTranslucent(ColorIndex))
+			return false;
+
+		const lcVector4& Value = gColorList[ColorIndex].Value;
+
+		switch (RenderMesh.State)
+		{
+		case lcRenderMeshState::Default:
+		case lcRenderMeshState::Highlighted:
+			Color = Value;
+			break;
+
+		case lcRenderMeshState::Selected:
+			Color = lcVector4(lcVector3(Value * 0.5f + mSelectedColor * 0.5f), Value.w);
+			break;
+
+		case lcRenderMeshState::Focused:
+			Color = lcVector4(lcVector3(Value * 0.5f + mFocusedColor * 0.5f), Value.w);
+			break;
+
+		case lcRenderMeshState::Faded:
+			if (mTranslucentFade)
+				return false;
+			Color = Value * mFadeColor;
+			break;
+		}
+	}
+	else
+	{
+		switch (RenderMesh.State)
+		{
+		case lcRenderMeshState::Default:
+			if (mShadingMode != lcShadingMode::Wireframe)
+			{
+				if (ColorIndex != gEdgeColor)
+					Color = gColorList[ColorIndex].Value;
+				else
+					Color = gColorList[RenderMesh.ColorIndex].Edge;
+			}
+			else
+			{
+				if (ColorIndex == gEdgeColor)
+					ColorIndex = RenderMesh.ColorIndex;
+
+				Color = gColorList[ColorIndex].Value;
+			}
+			break;
+
+		case lcRenderMeshState::Selected:
+			Color = mSelectedColor;
+			break;
+
+		case lcRenderMeshState::Focused:
+			Color = mFocusedColor;
+			break;
+
+		case lcRenderMeshState::Highlighted:
+			Color = mHighlightColor;
+			break;
+
+		case lcRenderMeshState::Faded:
+			Color = gColorList[ColorIndex].Edge * mFadeColor;
+			break;
+		}
+	}
+
+	return true;
+}
+
+void lcScene::DrawInstancedMeshes(lcContext* Context, bool DrawLit, int PrimitiveTypes, bool DrawFaded, bool DrawNonFaded) const
+{
+	mInstancedMeshes.assign(mRenderMeshes.GetSize(), false);
+
+	const int InstancedPrimitiveTypes = PrimitiveTypes & (LC_MESH_TRIANGLES | LC_MESH_LINES);
+
+	if (!gSupportsInstancing || !InstancedPrimitiveTypes)
+		return;
+
+	const lcMaterialType Material = DrawLit ? lcMaterialType::FakeLitColorInstanced : lcMaterialType::UnlitColorInstanced;
+	std::vector<int> LodMeshes[LC_NUM_MESH_LODS];
+
+	// Opaque meshes are sorted by mesh so all copies of the same mesh are next to each other.
+	for (int OpaqueIdx = 0; OpaqueIdx < mOpaqueMeshes.GetSize(); )
+	{
+		const lcMesh* Mesh = mRenderMeshes[mOpaqueMeshes[OpaqueIdx]].Mesh;
+
+		for (std::vector<int>& Meshes : LodMeshes)
+			Meshes.clear();
+
+		for (; OpaqueIdx < mOpaqueMeshes.GetSize(); OpaqueIdx++)
+		{
+			const int MeshIndex = mOpaqueMeshes[OpaqueIdx];
+			const lcRenderMesh& RenderMesh = mRenderMeshes[MeshIndex];
+
+			if (RenderMesh.Mesh != Mesh)
+				break;
+
+			if (!mVisibleMeshes[MeshIndex])
+				continue;
+
+			if (!DrawFaded && RenderMesh.State == lcRenderMeshState::Faded)
+				continue;
+
+			if (!DrawNonFaded && RenderMesh.State != lcRenderMeshState::Faded)
+				continue;
+
+			LodMeshes[RenderMesh.LodIndex].push_back(MeshIndex);
+		}
+
+		if (Mesh->mVertexCacheOffset == -1)
+			continue;
+
+		const int VertexBufferOffset = Mesh->mVertexCacheOffset;
+		const int IndexBufferOffset = Mesh->mIndexCacheOffset;
+		const lcMatrix44& DequantizeMatrix = Mesh->mDequantizeMatrix;
+
+		for (int LodIdx = 0; LodIdx < LC_NUM_MESH_LODS; LodIdx++)
+		{
+			const std::vector<int>& Meshes = LodMeshes[LodIdx];
+
+			if (Meshes.size() < LC_SCENE_MIN_INSTANCES)
+				continue;
+
+			Context->BindMesh(Mesh);
+
+			for (int SectionIdx = 0; SectionIdx < Mesh->mLods[LodIdx].NumSections; SectionIdx++)
+			{
+				const lcMeshSection* const Section = &Mesh->mLods[LodIdx].Sections[SectionIdx];
+
+				if ((Section->PrimitiveType & InstancedPrimitiveTypes) == 0)
+					continue;
+
+				mInstanceData.clear();
+
+				for (const int MeshIndex : Meshes)
+				{
+					const lcRenderMesh& RenderMesh = mRenderMeshes[MeshIndex];
+					lcInstanceData Instance;
+
+					if (!GetOpaqueSectionColor(RenderMesh, Section, Instance.Color))
+						continue;
+
+					Instance.WorldMatrix = Mesh->mCompactVertices ? lcMul(DequantizeMatrix, RenderMesh.WorldMatrix) : RenderMesh.WorldMatrix;
+					mInstanceData.push_back(Instance);
+				}
+
+				if (mInstanceData.empty())
+					continue;
+
+				Context->SetMaterial(Material);
+
+				if (Mesh->mCompactVertices)
+					Context->SetVertexFormatCompact(VertexBufferOffset, 0, DrawLit);
+				else
+					Context->SetVertexFormat(VertexBufferOffset, 3, 1, 0, 0, DrawLit);
+
+				const GLenum DrawPrimitiveType = Section->PrimitiveType == LC_MESH_TRIANGLES ? GL_TRIANGLES : GL_LINES;
+				Context->DrawIndexedPrimitivesInstanced(DrawPrimitiveType, Section->NumIndices, Mesh->mIndexType, IndexBufferOffset + Section->IndexOffset, mInstanceData.data(), static_cast<int>(mInstanceData.size()));
+				mStats.DrawCalls++;
+			}
+
+			for (const int MeshIndex : Meshes)
+				mInstancedMeshes[MeshIndex] = true;
+		}
+	}
+}
+
 void lcScene::DrawOpaqueMeshes(lcContext* Context, bool DrawLit, int PrimitiveTypes, bool DrawFaded, bool DrawNonFaded) const
 {
 	if (mOpaqueMeshes.IsEmpty())
 		return;
 
-	lcMaterialType FlatMaterial, TexturedMaterial;
+	lcMaterialType FlatMaterial, TexturedMaterial, ObjectMaterial;
 
 	if (DrawLit)
 	{
 		FlatMaterial = lcMaterialType::FakeLitColor;
 		TexturedMaterial = lcMaterialType::FakeLitTextureDecal;
+		ObjectMaterial = lcMaterialType::FakeLitColorObject;
 	}
 	else
 	{
 		FlatMaterial = lcMaterialType::UnlitColor;
 		TexturedMaterial = lcMaterialType::UnlitTextureDecal;
+		ObjectMaterial = lcMaterialType::UnlitColorObject;
 	}
 
 	Context->SetPolygonOffset(lcPolygonOffset::Opaque);
 
-	const lcPreferences& Preferences = lcGetPreferences();
-	const lcVector4 FocusedColor = lcVector4FromColor(Preferences.mObjectFocusedColor);
-	const lcVector4 SelectedColor = lcVector4FromColor(Preferences.mObjectSelectedColor);
+	DrawInstancedMeshes(Context, DrawLit, PrimitiveTypes, DrawFaded, DrawNonFaded);
 
 	for (const int MeshIndex : mOpaqueMeshes)
 	{
+		if (!mVisibleMeshes[MeshIndex])
+			continue;
+
 		const lcRenderMesh& RenderMesh = mRenderMeshes[MeshIndex];
 		const lcMesh* Mesh = RenderMesh.Mesh;
 		const int LodIndex = RenderMesh.LodIndex;
@@ -172,7 +651,7 @@ void lcScene::DrawOpaqueMeshes(lcContext* Context, bool DrawLit, int PrimitiveTy
 			continue;
 
 		Context->BindMesh(Mesh);
-		Context->SetWorldMatrix(RenderMesh.WorldMatrix);
+		Context->SetWorldMatrix(Mesh->mCompactVertices ? lcMul(Mesh->mDequantizeMatrix, RenderMesh.WorldMatrix) : RenderMesh.WorldMatrix);
 
 		for (int SectionIdx = 0; SectionIdx < Mesh->mLods[LodIndex].NumSections; SectionIdx++)
 		{
@@ -181,89 +660,29 @@ void lcScene::DrawOpaqueMeshes(lcContext* Context, bool DrawLit, int PrimitiveTy
 			if ((Section->PrimitiveType & PrimitiveTypes) == 0)
 				continue;
 
-			int ColorIndex = Section->ColorIndex;
-
-			if (Section->PrimitiveType & (LC_MESH_TRIANGLES | LC_MESH_TEXTURED_TRIANGLES))
-			{
-				if (ColorIndex == gDefaultColor)
-					ColorIndex = RenderMesh.ColorIndex;
-
-				if (lcIsColorTranslucent(ColorIndex))
-					continue;
-
-				switch (RenderMesh.State)
-				{
-				case lcRenderMeshState::Default:
-				case lcRenderMeshState::Highlighted:
-					Context->SetColorIndex(ColorIndex);
-					break;
+			if (mInstancedMeshes[MeshIndex] && (Section->PrimitiveType & (LC_MESH_TRIANGLES | LC_MESH_LINES)))
+				continue;
 
-				case lcRenderMeshState::Selected:
-					Context->SetColorIndexTinted(ColorIndex, SelectedColor, 0.5f);
-					break;
+			lcVector4 Color;
 
-				case lcRenderMeshState::Focused:
-					Context->SetColorIndexTinted(ColorIndex, FocusedColor, 0.5f);
-					break;
+			if (!GetOpaqueSectionColor(RenderMesh, Section, Color))
+				continue;
 
-				case lcRenderMeshState::Faded:
-					if (mTranslucentFade)
-						continue;
-					Context->SetColorIndexTinted(ColorIndex, mFadeColor);
-					break;
-				}
-			}
-			else if (Section->PrimitiveType & (LC_MESH_LINES | LC_MESH_CONDITIONAL_LINES))
+			if (Section->PrimitiveType == LC_MESH_CONDITIONAL_LINES)
 			{
-				switch (RenderMesh.State)
-				{
-				case lcRenderMeshState::Default:
-					if (mShadingMode != lcShadingMode::Wireframe)
-					{
-						if (ColorIndex != gEdgeColor)
-							Context->SetColorIndex(ColorIndex);
-						else
-							Context->SetEdgeColorIndex(RenderMesh.ColorIndex);
-					}
-					else
-					{
-						if (ColorIndex == gEdgeColor)
-							ColorIndex = RenderMesh.ColorIndex;
-
-						Context->SetColorIndex(ColorIndex);
-					}
-					break;
-
-				case lcRenderMeshState::Selected:
-					Context->SetColor(SelectedColor);
-					break;
-
-				case lcRenderMeshState::Focused:
-					Context->SetColor(FocusedColor);
-					break;
-
-				case lcRenderMeshState::Highlighted:
-					Context->SetColor(mHighlightColor);
-					break;
-
-				case lcRenderMeshState::Faded:
-					Context->SetEdgeColorIndexTinted(ColorIndex, mFadeColor);
-					break;
-				}
+				Context->SetColor(Color);
 
-				if (Section->PrimitiveType == LC_MESH_CONDITIONAL_LINES)
-				{
-					int VertexBufferOffset = Mesh->mVertexCacheOffset != -1 ? Mesh->mVertexCacheOffset : 0;
-					VertexBufferOffset += Mesh->mNumVertices * sizeof(lcVertex) + Mesh->mNumTexturedVertices * sizeof(lcVertexTextured);
-					const int IndexBufferOffset = Mesh->mIndexCacheOffset != -1 ? Mesh->mIndexCacheOffset : 0;
+				int VertexBufferOffset = Mesh->mVertexCacheOffset != -1 ? Mesh->mVertexCacheOffset : 0;
+				VertexBufferOffset += Mesh->GetConditionalVertexBufferOffset();
+				const int IndexBufferOffset = Mesh->mIndexCacheOffset != -1 ? Mesh->mIndexCacheOffset : 0;
 
-					Context->SetMaterial(lcMaterialType::UnlitColorConditional);
-					Context->SetVertexFormatConditional(VertexBufferOffset);
+				Context->SetMaterial(lcMaterialType::UnlitColorConditional);
+				Context->SetVertexFormatConditional(VertexBufferOffset, Mesh->mCompactVertices);
 
-					Context->DrawIndexedPrimitives(GL_LINES, Section->NumIndices, Mesh->mIndexType, IndexBufferOffset + Section->IndexOffset);
+				Context->DrawIndexedPrimitives(GL_LINES, Section->NumIndices, Mesh->mIndexType, IndexBufferOffset + Section->IndexOffset);
+				mStats.DrawCalls++;
 
-					continue;
-				}
+				continue;
 			}
 
 			int VertexBufferOffset = Mesh->mVertexCacheOffset != -1 ? Mesh->mVertexCacheOffset : 0;
@@ -271,13 +690,31 @@ void lcScene::DrawOpaqueMeshes(lcContext* Context, bool DrawLit, int PrimitiveTy
 
 			if (Section->PrimitiveType != LC_MESH_TEXTURED_TRIANGLES)
 			{
-				Context->SetMaterial(FlatMaterial);
-				Context->SetVertexFormat(VertexBufferOffset, 3, 1, 0, 0, DrawLit);
+				// The object material reads the color from the object buffer.
+				if (mUseObjectBuffer)
+				{
+					const int MatrixOffset = mObjectOffsets[MeshIndex];
+
+					Context->SetMaterial(ObjectMaterial);
+					Context->SetObjectOffsets(MatrixOffset, MatrixOffset + 4 + SectionIdx);
+				}
+				else
+				{
+					Context->SetMaterial(FlatMaterial);
+					Context->SetColor(Color);
+				}
+
+				if (Mesh->mCompactVertices)
+					Context->SetVertexFormatCompact(VertexBufferOffset, 0, DrawLit);
+				else
+					Context->SetVertexFormat(VertexBufferOffset, 3, 1, 0, 0, DrawLit);
 			}
 			else
 			{
 				lcTexture* const Texture = Section->Texture;
 
+				Context->SetColor(Color);
+
 				if (Texture)
 				{
 					if (Texture->NeedsUpload())
@@ -291,12 +728,15 @@ void lcScene::DrawOpaqueMeshes(lcContext* Context, bool DrawLit, int PrimitiveTy
 					Context->SetMaterial(FlatMaterial);
 				}
 
-				VertexBufferOffset += Mesh->mNumVertices * sizeof(lcVertex);
-				Context->SetVertexFormat(VertexBufferOffset, 3, 1, 2, 0, DrawLit);
+				VertexBufferOffset += Mesh->GetTexturedVertexBufferOffset();
+
+				if (Mesh->mCompactVertices)
+					Context->SetVertexFormatCompact(VertexBufferOffset, 2, DrawLit);
+				else
+					Context->SetVertexFormat(VertexBufferOffset, 3, 1, 2, 0, DrawLit);
 			}
 
-			const GLenum DrawPrimitiveType = Section->PrimitiveType & (LC_MESH_TRIANGLES | LC_MESH_TEXTURED_TRIANGLES) ? GL_TRIANGLES : GL_LINES;
-			Context->DrawIndexedPrimitives(DrawPrimitiveType, Section->NumIndices, Mesh->mIndexType, IndexBufferOffset + Section->IndexOffset);
+			DrawSection(Context, RenderMesh, Section, IndexBufferOffset, &mMeshFrustumPlanes[MeshIndex * 6]);
 		}
 
 #ifdef LC_DEBUG_NORMALS
@@ -336,12 +776,11 @@ void lcScene::DrawTranslucentMeshes(lcContext* Context, bool DrawLit, bool DrawF
 
 	Context->SetPolygonOffset(lcPolygonOffset::Translucent);
 
-	const lcPreferences& Preferences = lcGetPreferences();
-	const lcVector4 FocusedColor = lcVector4FromColor(Preferences.mObjectFocusedColor);
-	const lcVector4 SelectedColor = lcVector4FromColor(Preferences.mObjectSelectedColor);
-
 	for (const lcTranslucentMeshInstance& MeshInstance : mTranslucentMeshes)
 	{
+		if (!mVisibleMeshes[MeshInstance.RenderMeshIndex])
+			continue;
+
 		const lcRenderMesh& RenderMesh = mRenderMeshes[MeshInstance.RenderMeshIndex];
 		const lcMesh* Mesh = RenderMesh.Mesh;
 
@@ -352,7 +791,7 @@ void lcScene::DrawTranslucentMeshes(lcContext* Context, bool DrawLit, bool DrawF
 			continue;
 
 		Context->BindMesh(Mesh);
-		Context->SetWorldMatrix(RenderMesh.WorldMatrix);
+		Context->SetWorldMatrix(Mesh->mCompactVertices ? lcMul(Mesh->mDequantizeMatrix, RenderMesh.WorldMatrix) : RenderMesh.WorldMatrix);
 
 		const lcMeshSection* Section = MeshInstance.Section;
 
@@ -372,11 +811,11 @@ void lcScene::DrawTranslucentMeshes(lcContext* Context, bool DrawLit, bool DrawF
 			break;
 
 		case lcRenderMeshState::Selected:
-			Context->SetColorIndexTinted(ColorIndex, SelectedColor, 0.5f);
+			Context->SetColorIndexTinted(ColorIndex, mSelectedColor, 0.5f);
 			break;
 
 		case lcRenderMeshState::Focused:
-			Context->SetColorIndexTinted(ColorIndex, FocusedColor, 0.5f);
+			Context->SetColorIndexTinted(ColorIndex, mFocusedColor, 0.5f);
 			break;
 
 		case lcRenderMeshState::Faded:
@@ -391,20 +830,27 @@ void lcScene::DrawTranslucentMeshes(lcContext* Context, bool DrawLit, bool DrawF
 		if (!Texture)
 		{
 			Context->SetMaterial(FlatMaterial);
-			Context->SetVertexFormat(VertexBufferOffset, 3, 1, 0, 0, DrawLit);
+
+			if (Mesh->mCompactVertices)
+				Context->SetVertexFormatCompact(VertexBufferOffset, 0, DrawLit);
+			else
+				Context->SetVertexFormat(VertexBufferOffset, 3, 1, 0, 0, DrawLit);
 		}
 		else
 		{
 			if (Texture->NeedsUpload())
 				Texture->Upload(Context);
 			Context->SetMaterial(TexturedMaterial);
-			VertexBufferOffset += Mesh->mNumVertices * sizeof(lcVertex);
-			Context->SetVertexFormat(VertexBufferOffset, 3, 1, 2, 0, DrawLit);
+			VertexBufferOffset += Mesh->GetTexturedVertexBufferOffset();
+
+			if (Mesh->mCompactVertices)
+				Context->SetVertexFormatCompact(VertexBufferOffset, 2, DrawLit);
+			else
+				Context->SetVertexFormat(VertexBufferOffset, 3, 1, 2, 0, DrawLit);
 			Context->BindTexture2D(Texture);
 		}
 
-		const GLenum DrawPrimitiveType = Section->PrimitiveType & (LC_MESH_TRIANGLES | LC_MESH_TEXTURED_TRIANGLES) ? GL_TRIANGLES : GL_LINES;
-		Context->DrawIndexedPrimitives(DrawPrimitiveType, Section->NumIndices, Mesh->mIndexType, IndexBufferOffset + Section->IndexOffset);
+		DrawSection(Context, RenderMesh, Section, IndexBufferOffset, &mMeshFrustumPlanes[MeshInstance.RenderMeshIndex * 6]);
 
 #ifdef LC_DEBUG_NORMALS
 		DrawDebugNormals(Context, Mesh);
@@ -430,6 +876,13 @@ void lcScene::Draw(lcContext* Context) const
 
 	Context->SetViewMatrix(mViewMatrix);
 
+	// The counters describe a single Draw() so they don't add up across frames and tiles, only the meshes culled when the scene was built carry over.
+	mStats = lcSceneStats();
+	mStats.CulledMeshes = mSceneCulledMeshes;
+
+	UpdateVisibleMeshes(Context);
+	UpdateObjectData(Context);
+
 	const lcPreferences& Preferences = lcGetPreferences();
 	const bool DrawLines = Preferences.mDrawEdgeLines && Preferences.mLineWidth > 0.0f;
 	const bool DrawConditional = Preferences.mDrawConditionalLines && Preferences.mLineWidth > 0.0f;
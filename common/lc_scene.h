@@ -2,6 +2,7 @@
 
 #include "lc_mesh.h"
 #include "lc_array.h"
+#include "lc_context.h"
 
 enum class lcRenderMeshState : int
 {
@@ -12,6 +13,14 @@ enum class lcRenderMeshState : int
 	Highlighted
 };
 
+struct lcSceneMesh
+{
+	lcMatrix44 WorldMatrix;
+	lcMesh* Mesh;
+	int ColorIndex;
+	lcRenderMeshState State;
+};
+
 struct lcRenderMesh
 {
 	lcMatrix44 WorldMatrix;
@@ -28,6 +37,15 @@ struct lcTranslucentMeshInstance
 	float Distance;
 };
 
+struct lcSceneStats
+{
+	int CulledMeshes;
+	int DrawnMeshes;
+	int DrawCalls;
+	int CulledClusters;
+	int CulledTriangles;
+};
+
 class lcScene
 {
 public:
@@ -74,6 +92,14 @@ public:
 		mMeshLODDistance = Distance;
 	}
 
+	const lcSceneStats& GetStats() const
+	{
+		return mStats;
+	}
+
+	void SetViewMatrix(const lcMatrix44& ViewMatrix);
+	void SetCullingProjection(const lcMatrix44& ProjectionMatrix);
+
 	void SetPreTranslucentCallback(std::function<void()> Callback)
 	{
 		mPreTranslucentCallback = Callback;
@@ -97,8 +123,16 @@ public:
 	void DrawInterfaceObjects(lcContext* Context) const;
 
 protected:
+	float GetProjectedSize(float Radius, float ViewDepth) const;
+	void AddSceneMesh(const lcSceneMesh& SceneMesh);
+	void AddRenderMesh(lcMesh* Mesh, const lcMatrix44& WorldMatrix, int ColorIndex, lcRenderMeshState State, int LodIndex);
+	void UpdateVisibleMeshes(lcContext* Context) const;
+	void UpdateObjectData(lcContext* Context) const;
+	bool GetOpaqueSectionColor(const lcRenderMesh& RenderMesh, const lcMeshSection* Section, lcVector4& Color) const;
+	void DrawInstancedMeshes(lcContext* Context, bool DrawLit, int PrimitiveTypes, bool DrawFaded, bool DrawNonFaded) const;
 	void DrawOpaqueMeshes(lcContext* Context, bool DrawLit, int PrimitiveTypes, bool DrawFaded, bool DrawNonFaded) const;
 	void DrawTranslucentMeshes(lcContext* Context, bool DrawLit, bool DrawFadePrepass, bool DrawFaded, bool DrawNonFaded) const;
+	void DrawSection(lcContext* Context, const lcRenderMesh& RenderMesh, const lcMeshSection* Section, int IndexBufferOffset, const lcVector4* Planes) const;
 	void DrawDebugNormals(lcContext* Context, const lcMesh* Mesh) const;
 
 	lcMatrix44 mViewMatrix;
@@ -108,15 +142,36 @@ protected:
 	bool mDrawInterface;
 	bool mAllowLOD;
 	float mMeshLODDistance;
+	bool mFrustumCulling;
+	lcVector4 mFrustumPlanes[6];
+	lcMatrix44 mCullingProjection;
 
 	lcVector4 mFadeColor;
 	lcVector4 mHighlightColor;
+	lcVector4 mFocusedColor;
+	lcVector4 mSelectedColor;
 	bool mHasFadedParts;
 	bool mTranslucentFade;
 
 	std::function<void()> mPreTranslucentCallback;
+	lcArray<lcSceneMesh> mSceneMeshes;
 	lcArray<lcRenderMesh> mRenderMeshes;
 	lcArray<int> mOpaqueMeshes;
 	lcArray<lcTranslucentMeshInstance> mTranslucentMeshes;
+	std::vector<quint64> mOpaqueSortKeys;
+	std::vector<quint32> mTranslucentSortKeys;
+	std::vector<quint64> mOpaqueSortKeyBuffer;
+	std::vector<quint32> mTranslucentSortKeyBuffer;
+	std::vector<int> mOpaqueMeshBuffer;
+	std::vector<lcTranslucentMeshInstance> mTranslucentMeshBuffer;
 	lcArray<const lcObject*> mInterfaceObjects;
+
+	mutable std::vector<bool> mVisibleMeshes;
+	mutable std::vector<lcVector4> mMeshFrustumPlanes;
+	mutable std::vector<bool> mInstancedMeshes;
+	mutable std::vector<int> mObjectOffsets;
+	mutable bool mUseObjectBuffer;
+	mutable std::vector<lcInstanceData> mInstanceData;
+	int mSceneCulledMeshes;
+	mutable lcSceneStats mStats;
 };
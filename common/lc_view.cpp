@@ -10,6 +10,7 @@
 #include "pieceinf.h"
 #include "lc_synth.h"
 #include "lc_scene.h"
+#include "lc_library.h"
 #include "lc_context.h"
 #include "lc_viewmanipulator.h"
 #include "lc_viewsphere.h"
@@ -92,12 +93,27 @@ void lcView::UpdateAllViews()
 		View->Redraw();
 }
 
+void lcView::UpdateCameraViews(const lcCamera* Camera)
+{
+	for (lcView* View : mViews)
+		if (View->mCamera == Camera)
+			View->RedrawCamera();
+}
+
 void lcView::MakeCurrent()
 {
 	mContext->MakeCurrent();
 }
 
 void lcView::Redraw()
+{
+	mSceneValid = false;
+
+	if (mWidget)
+		mWidget->update();
+}
+
+void lcView::RedrawCamera()
 {
 	if (mWidget)
 		mWidget->update();
@@ -151,6 +167,7 @@ void lcView::SetTopSubmodelActive()
 	}
 
 	GetActiveModel()->UpdateInterface();
+	Redraw();
 }
 
 void lcView::SetSelectedSubmodelActive()
@@ -180,6 +197,7 @@ void lcView::SetSelectedSubmodelActive()
 	}
 
 	GetActiveModel()->UpdateInterface();
+	Redraw();
 }
 
 void lcView::CreateResources(lcContext* Context)
@@ -804,48 +822,87 @@ void lcView::OnDraw()
 	mScene->SetAllowLOD(Preferences.mAllowLOD && mWidget != nullptr);
 	mScene->SetLODDistance(Preferences.mMeshLODDistance);
 
-	mScene->Begin(mCamera->mWorldView);
-
-	mScene->SetActiveSubmodelInstance(mActiveSubmodelInstance, mActiveSubmodelTransform);
-	mScene->SetDrawInterface(DrawInterface);
-
-	mModel->GetScene(mScene.get(), mCamera, Preferences.mHighlightNewParts, Preferences.mFadeSteps);
+	int TotalTileRows = 1;
+	int TotalTileColumns = 1;
 
-	if (DrawInterface && mTrackTool == lcTrackTool::Insert)
+	if (!mRenderImage.isNull())
 	{
-		PieceInfo* Info = gMainWindow->GetCurrentPieceInfo();
+		int ImageWidth = mRenderImage.width();
+		int ImageHeight = mRenderImage.height();
 
-		if (Info)
+		if (ImageWidth > mWidth || ImageHeight > mHeight)
 		{
-			lcMatrix44 WorldMatrix = GetPieceInsertPosition(false, Info);
-
-			if (GetActiveModel() != mModel)
-				WorldMatrix = lcMul(WorldMatrix, mActiveSubmodelTransform);
-
-			Info->AddRenderMeshes(mScene.get(), WorldMatrix, gMainWindow->mColorIndex, lcRenderMeshState::Focused, false);
+			TotalTileColumns = (mWidth + ImageWidth - 1) / mWidth;
+			TotalTileRows = (mHeight + ImageHeight - 1) / mHeight;
 		}
 	}
 
-	if (DrawInterface)
-		mScene->SetPreTranslucentCallback([this]() { DrawGrid(); });
+#ifdef LC_PROFILE_DRAW
+	QElapsedTimer SceneTimer;
+	SceneTimer.start();
+#endif
 
-	mScene->End();
+	// Widgets keep the scene between frames, it's only rebuilt after the views are notified of a change
+	// to the model or a mesh was loaded or released, camera changes only update the view dependent data.
+	const bool InsertPreview = DrawInterface && mTrackTool == lcTrackTool::Insert;
+	const bool RetainScene = mWidget && !InsertPreview;
+	const int MeshStamp = lcGetPiecesLibrary()->GetMeshStamp();
+	const bool UpdateScene = !RetainScene || !mSceneValid || mSceneMeshStamp != MeshStamp || mSceneModel != mModel || mSceneCamera != mCamera;
 
-	int TotalTileRows = 1;
-	int TotalTileColumns = 1;
+	if (UpdateScene)
+		mScene->Begin(mCamera->mWorldView);
+	else
+		mScene->SetViewMatrix(mCamera->mWorldView);
 
-	if (!mRenderImage.isNull())
+	if (TotalTileRows > 1 || TotalTileColumns > 1)
+		mScene->SetCullingProjection(GetTileProjectionMatrix(0, 0, mRenderImage.width(), mRenderImage.height()));
+	else
+		mScene->SetCullingProjection(GetProjectionMatrix());
+
+	if (UpdateScene)
 	{
-		int ImageWidth = mRenderImage.width();
-		int ImageHeight = mRenderImage.height();
+		mScene->SetActiveSubmodelInstance(mActiveSubmodelInstance, mActiveSubmodelTransform);
+		mScene->SetDrawInterface(DrawInterface);
 
-		if (ImageWidth > mWidth || ImageHeight > mHeight)
+		mModel->GetScene(mScene.get(), mCamera, Preferences.mHighlightNewParts, Preferences.mFadeSteps);
+
+		if (InsertPreview)
 		{
-			TotalTileColumns = (mWidth + ImageWidth - 1) / mWidth;
-			TotalTileRows = (mHeight + ImageHeight - 1) / mHeight;
+			PieceInfo* Info = gMainWindow->GetCurrentPieceInfo();
+
+			if (Info)
+			{
+				lcMatrix44 WorldMatrix = GetPieceInsertPosition(false, Info);
+
+				if (GetActiveModel() != mModel)
+					WorldMatrix = lcMul(WorldMatrix, mActiveSubmodelTransform);
+
+				Info->AddRenderMeshes(mScene.get(), WorldMatrix, gMainWindow->mColorIndex, lcRenderMeshState::Focused, false);
+			}
 		}
+
+		if (DrawInterface)
+			mScene->SetPreTranslucentCallback([this]() { DrawGrid(); });
+
+		mSceneValid = RetainScene;
+		mSceneMeshStamp = MeshStamp;
+		mSceneModel = mModel;
+		mSceneCamera = mCamera;
 	}
 
+	mScene->End();
+
+#ifdef LC_PROFILE_DRAW
+	static std::array<qint64, 30> SceneResults;
+	static qint64 SceneRebuildTime;
+
+	const qint64 SceneElapsed = SceneTimer.nsecsElapsed();
+	SceneResults[FrameNumber % SceneResults.size()] = SceneElapsed;
+
+	if (UpdateScene)
+		SceneRebuildTime = SceneElapsed;
+#endif
+
 	for (int CurrentTileRow = 0; CurrentTileRow < TotalTileRows; CurrentTileRow++)
 	{
 		for (int CurrentTileColumn = 0; CurrentTileColumn < TotalTileColumns; CurrentTileColumn++)
@@ -962,11 +1019,19 @@ void lcView::OnDraw()
 		TimerAverage += Result;
 	TimerAverage /= TimerResults.size();
 
+	qint64 SceneAverage = 0;
+	for (qint64 Result : SceneResults)
+		SceneAverage += Result;
+	SceneAverage /= SceneResults.size();
+
 	mContext->SetWorldMatrix(lcMatrix44Identity());
 	mContext->SetViewMatrix(lcMatrix44Translation(lcVector3(0.375, 0.375, 0.0)));
 	mContext->SetProjectionMatrix(lcMatrix44Ortho(0.0f, mWidth, 0.0f, mHeight, -1.0f, 1.0f));
 
-	QString Line = QString("GPU: %1 CPU: %2").arg(QString::number(QueryAverage / 1000000.0, 'f', 2), QString::number(TimerAverage / 1000000.0, 'f', 2));
+	const lcSceneStats& SceneStats = mScene->GetStats();
+	QString Line = QString("GPU: %1 CPU: %2 Draws: %3 Meshes: %4 Culled: %5 Culled Clusters: %6 (%7 Triangles)").arg(QString::number(QueryAverage / 1000000.0, 'f', 2), QString::number(TimerAverage / 1000000.0, 'f', 2));
+	Line = Line.arg(SceneStats.DrawCalls).arg(SceneStats.DrawnMeshes).arg(SceneStats.CulledMeshes).arg(SceneStats.CulledClusters).arg(SceneStats.CulledTriangles);
+	Line += QString(" Scene: %1 Rebuild: %2").arg(QString::number(SceneAverage / 1000000.0, 'f', 2), QString::number(SceneRebuildTime / 1000000.0, 'f', 2));
 
 	mContext->SetMaterial(lcMaterialType::UnlitTextureModulate);
 	mContext->SetColor(lcVector4FromColor(lcGetPreferences().mTextColor));
@@ -980,7 +1045,7 @@ void lcView::OnDraw()
 	mContext->EnableColorBlend(false);
 	mContext->EnableDepthTest(true);
 
-	Redraw();
+	RedrawCamera();
 #endif
 
 	mContext->ClearResources();
@@ -192,12 +192,14 @@ public:
 	static std::vector<lcView*> GetModelViews(const lcModel* Model);
 	static void UpdateProjectViews(const Project* Project);
 	static void UpdateAllViews();
+	static void UpdateCameraViews(const lcCamera* Camera);
 
 	static void CreateResources(lcContext* Context);
 	static void DestroyResources(lcContext* Context);
 
 	void MakeCurrent();
 	void Redraw();
+	void RedrawCamera();
 
 	void SetOffscreenContext();
 
@@ -335,6 +337,10 @@ protected:
 	quint32 mBackgroundColor = 0;
 
 	std::unique_ptr<lcScene> mScene;
+	bool mSceneValid = false;
+	int mSceneMeshStamp = 0;
+	const lcModel* mSceneModel = nullptr;
+	const lcCamera* mSceneCamera = nullptr;
 	std::unique_ptr<lcViewManipulator> mViewManipulator;
 	std::unique_ptr<lcViewSphere> mViewSphere;
 
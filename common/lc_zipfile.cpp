@@ -11,9 +11,79 @@
 #  define DEF_MEM_LEVEL  MAX_MEM_LEVEL
 #endif
 
+// Read only view of a mapped archive, each extraction uses its own so they don't share a file position.
+class lcZipMappedFile : public lcFile
+{
+public:
+	lcZipMappedFile(const char* Data, size_t Length)
+		: mData(Data), mLength(Length), mPosition(0)
+	{
+	}
+
+	long GetPosition() const override
+	{
+		return (long)mPosition;
+	}
+
+	void Seek(qint64 Offset, int From) override
+	{
+		if (From == SEEK_SET)
+			mPosition = Offset;
+		else if (From == SEEK_CUR)
+			mPosition += Offset;
+		else if (From == SEEK_END)
+			mPosition = mLength + Offset;
+	}
+
+	size_t GetLength() const override
+	{
+		return mLength;
+	}
+
+	void Close() override
+	{
+	}
+
+	char* ReadLine(char* Buffer, size_t BufferSize) override
+	{
+		Q_UNUSED(Buffer);
+		Q_UNUSED(BufferSize);
+
+		return nullptr;
+	}
+
+	size_t ReadBuffer(void* Buffer, size_t Bytes) override
+	{
+		if (mPosition >= mLength)
+			return 0;
+
+		const size_t BytesToRead = qMin(Bytes, mLength - mPosition);
+
+		memcpy(Buffer, mData + mPosition, BytesToRead);
+		mPosition += BytesToRead;
+
+		return BytesToRead;
+	}
+
+	size_t WriteBuffer(const void* Buffer, size_t Bytes) override
+	{
+		Q_UNUSED(Buffer);
+		Q_UNUSED(Bytes);
+
+		return 0;
+	}
+
+protected:
+	const char* mData;
+	size_t mLength;
+	size_t mPosition;
+};
+
 lcZipFile::lcZipFile()
 {
 	mModified = false;
+	mMappedData = nullptr;
+	mMappedSize = 0;
 }
 
 lcZipFile::~lcZipFile()
@@ -40,6 +110,9 @@ bool lcZipFile::OpenRead(std::unique_ptr<lcFile> File)
 		return false;
 	}
 
+	mMappedData = mFile->Map();
+	mMappedSize = mMappedData ? mFile->GetLength() : 0;
+
 	return true;
 }
 
@@ -187,7 +260,7 @@ quint64 lcZipFile::SearchCentralDir64()
 	return RelativeOffset;
 }
 
-bool lcZipFile::CheckFileCoherencyHeader(int FileIndex, quint32* SizeVar, quint64* OffsetLocalExtraField, quint32* SizeLocalExtraField)
+bool lcZipFile::CheckFileCoherencyHeader(lcFile& SourceFile, int FileIndex, quint32* SizeVar, quint64* OffsetLocalExtraField, quint32* SizeLocalExtraField)
 {
 	quint16 Number16, Flags;
 	quint32 Number32, Magic;
@@ -198,41 +271,41 @@ bool lcZipFile::CheckFileCoherencyHeader(int FileIndex, quint32* SizeVar, quint6
 	*OffsetLocalExtraField = 0;
 	*SizeLocalExtraField = 0;
 
-	mFile->Seek(FileInfo.offset_curfile + mBytesBeforeZipFile, SEEK_SET);
+	SourceFile.Seek(FileInfo.offset_curfile + mBytesBeforeZipFile, SEEK_SET);
 
-	if (mFile->ReadU32(&Magic, 1) != 1 || Magic != 0x04034b50)
+	if (SourceFile.ReadU32(&Magic, 1) != 1 || Magic != 0x04034b50)
 		return false;
 
-	if (mFile->ReadU16(&Number16, 1) != 1)
+	if (SourceFile.ReadU16(&Number16, 1) != 1)
 		return false;
 
-	if (mFile->ReadU16(&Flags, 1) != 1)
+	if (SourceFile.ReadU16(&Flags, 1) != 1)
 		return false;
 
-	if (mFile->ReadU16(&Number16, 1) != 1 || Number16 != FileInfo.compression_method)
+	if (SourceFile.ReadU16(&Number16, 1) != 1 || Number16 != FileInfo.compression_method)
 		return false;
 
 	if (FileInfo.compression_method != 0 && FileInfo.compression_method != Z_DEFLATED)
 		return false;
 
-	if (mFile->ReadU32(&Number32, 1) != 1)
+	if (SourceFile.ReadU32(&Number32, 1) != 1)
 		return false;
 
-	if (mFile->ReadU32(&Number32, 1) != 1 || ((Number32 != FileInfo.crc) && ((Flags & 8)==0)))
+	if (SourceFile.ReadU32(&Number32, 1) != 1 || ((Number32 != FileInfo.crc) && ((Flags & 8)==0)))
 		return false;
 
-	if (mFile->ReadU32(&Number32, 1) != 1 || (Number32 != 0xffffffffU && (Number32 != FileInfo.compressed_size) && ((Flags & 8)==0)))
+	if (SourceFile.ReadU32(&Number32, 1) != 1 || (Number32 != 0xffffffffU && (Number32 != FileInfo.compressed_size) && ((Flags & 8)==0)))
 		return false;
 
-	if (mFile->ReadU32(&Number32, 1) != 1 || (Number32 != 0xffffffffU && (Number32 != FileInfo.uncompressed_size) && ((Flags & 8)==0)))
+	if (SourceFile.ReadU32(&Number32, 1) != 1 || (Number32 != 0xffffffffU && (Number32 != FileInfo.uncompressed_size) && ((Flags & 8)==0)))
 		return false;
 
-	if (mFile->ReadU16(&SizeFilename, 1) != 1 || SizeFilename != FileInfo.size_filename)
+	if (SourceFile.ReadU16(&SizeFilename, 1) != 1 || SizeFilename != FileInfo.size_filename)
 		return false;
 
 	*SizeVar += SizeFilename;
 
-	if (mFile->ReadU16(&SizeExtraField, 1) != 1)
+	if (SourceFile.ReadU16(&SizeExtraField, 1) != 1)
 		return false;
 
 	*OffsetLocalExtraField= FileInfo.offset_curfile + 0x1e + SizeFilename;
@@ -564,32 +637,52 @@ bool lcZipFile::ReadCentralDir()
 		mFile->Seek(Seek, SEEK_CUR);
 	}
 
+	for (lcZipFileInfo& FileInfo : mFiles)
+		if (!mFileIndex.Find(FileInfo.file_name))
+			mFileIndex.Insert(FileInfo.file_name, &FileInfo);
+
 	return true;
 }
 
+int lcZipFile::FindFile(const char* FileName) const
+{
+	const lcZipFileInfo* FileInfo = mFileIndex.Find(FileName);
+
+	return FileInfo ? static_cast<int>(FileInfo - &mFiles[0]) : -1;
+}
+
 bool lcZipFile::ExtractFile(const char* FileName, lcMemFile& File, quint32 MaxLength)
 {
-	for (int FileIdx = 0; FileIdx < mFiles.GetSize(); FileIdx++)
-	{
-		lcZipFileInfo& FileInfo = mFiles[FileIdx];
+	const int FileIndex = FindFile(FileName);
 
-		if (!qstricmp(FileInfo.file_name, FileName))
-			return ExtractFile(FileIdx, File, MaxLength);
-	}
+	if (FileIndex == -1)
+		return false;
 
-	return false;
+	return ExtractFile(FileIndex, File, MaxLength);
 }
 
 bool lcZipFile::ExtractFile(int FileIndex, lcMemFile& File, quint32 MaxLength)
 {
+	if (mMappedData)
+	{
+		lcZipMappedFile SourceFile(mMappedData, mMappedSize);
+
+		return ExtractFile(FileIndex, File, MaxLength, SourceFile);
+	}
+
 	QMutexLocker Lock(&mMutex);
 
+	return ExtractFile(FileIndex, File, MaxLength, *mFile);
+}
+
+bool lcZipFile::ExtractFile(int FileIndex, lcMemFile& File, quint32 MaxLength, lcFile& SourceFile)
+{
 	quint32 SizeVar;
 	quint64 OffsetLocalExtraField;
 	quint32 SizeLocalExtraField;
 	const lcZipFileInfo& FileInfo = mFiles[FileIndex];
 
-	if (!CheckFileCoherencyHeader(FileIndex, &SizeVar, &OffsetLocalExtraField, &SizeLocalExtraField))
+	if (!CheckFileCoherencyHeader(SourceFile, FileIndex, &SizeVar, &OffsetLocalExtraField, &SizeLocalExtraField))
 		return false;
 
 	const int BufferSize = 16384;
@@ -644,8 +737,8 @@ bool lcZipFile::ExtractFile(int FileIndex, lcMemFile& File, quint32 MaxLength)
 			if (ReadThis == 0)
 				return false;
 
-			mFile->Seek(PosInZipfile + mBytesBeforeZipFile, SEEK_SET);
-			if (mFile->ReadBuffer(ReadBuffer, ReadThis) != ReadThis)
+			SourceFile.Seek(PosInZipfile + mBytesBeforeZipFile, SEEK_SET);
+			if (SourceFile.ReadBuffer(ReadBuffer, ReadThis) != ReadThis)
 				return false;
 
 			PosInZipfile += ReadThis;
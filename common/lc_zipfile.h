@@ -1,6 +1,7 @@
 #pragma once
 
 #include "lc_array.h"
+#include "lc_nameindex.h"
 
 #ifdef DeleteFile
 #undef DeleteFile
@@ -61,6 +62,7 @@ public:
 	bool OpenRead(std::unique_ptr<lcFile> File);
 	bool OpenWrite(const QString& FileName);
 
+	int FindFile(const char* FileName) const;
 	bool ExtractFile(int FileIndex, lcMemFile& File, quint32 MaxLength = 0xffffffff);
 	bool ExtractFile(const char* FileName, lcMemFile& File, quint32 MaxLength = 0xffffffff);
 
@@ -71,10 +73,15 @@ protected:
 	bool ReadCentralDir();
 	quint64 SearchCentralDir();
 	quint64 SearchCentralDir64();
-	bool CheckFileCoherencyHeader(int FileIndex, quint32* SizeVar, quint64* OffsetLocalExtraField, quint32* SizeLocalExtraField);
+	bool ExtractFile(int FileIndex, lcMemFile& File, quint32 MaxLength, lcFile& SourceFile);
+	bool CheckFileCoherencyHeader(lcFile& SourceFile, int FileIndex, quint32* SizeVar, quint64* OffsetLocalExtraField, quint32* SizeLocalExtraField);
 
 	QMutex mMutex;
 	std::unique_ptr<lcFile> mFile;
+	const char* mMappedData;
+	size_t mMappedSize;
+
+	lcNameIndex<lcZipFileInfo> mFileIndex;
 
 	bool mModified;
 	bool mZip64;
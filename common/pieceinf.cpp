@@ -21,6 +21,7 @@ PieceInfo::PieceInfo()
 	mFolderType = -1;
 	mFolderIndex = -1;
 	mState = lcPieceInfoState::Unloaded;
+	mUnusedStamp = 0;
 	mRefCount = 0;
 	mType = lcPieceInfoType::Part;
 	mMesh = nullptr;
@@ -44,6 +45,7 @@ void PieceInfo::SetMesh(lcMesh* Mesh)
 	mBoundingBox = Mesh->mBoundingBox;
 	ReleaseMesh();
 	mMesh = Mesh;
+	lcGetPiecesLibrary()->AddMesh(Mesh);
 }
 
 void PieceInfo::SetPlaceholder()
@@ -63,8 +65,7 @@ void PieceInfo::SetModel(lcModel* Model, bool UpdateMesh, Project* CurrentProjec
 	{
 		mType = lcPieceInfoType::Model;
 		mModel = Model;
-		delete mMesh;
-		mMesh = nullptr;
+		ReleaseMesh();
 	}
 
 	strncpy(mFileName, Model->GetProperties().mFileName.toLatin1().data(), sizeof(mFileName) - 1);
@@ -183,6 +184,7 @@ void PieceInfo::ReleaseMesh()
 			}
 		}
 
+		lcGetPiecesLibrary()->RemoveMesh(mMesh);
 		delete mMesh;
 		mMesh = nullptr;
 	}
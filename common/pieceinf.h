@@ -187,6 +187,7 @@ public:
 	lcZipFileType mZipFileType;
 	int mZipFileIndex;
 	lcPieceInfoState mState;
+	quint64 mUnusedStamp;
 	int mFolderType;
 	int mFolderIndex;
 
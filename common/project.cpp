@@ -425,6 +425,9 @@ bool Project::Load(const QString& FileName, bool ShowErrors)
 				delete Model;
 		}
 
+		lcPiecesLibrary* Library = lcGetPiecesLibrary();
+		Library->BeginBatchLoad();
+
 		for (size_t ModelIdx = 0; ModelIdx < Models.size(); ModelIdx++)
 		{
 			Buffer.seek(Models[ModelIdx].first);
@@ -432,6 +435,8 @@ bool Project::Load(const QString& FileName, bool ShowErrors)
 			Model->LoadLDraw(Buffer, this);
 			Model->SetSaved();
 		}
+
+		Library->EndBatchLoad();
 	}
 	else
 	{
@@ -647,6 +652,21 @@ std::vector<lcModelPartsEntry> Project::GetModelParts()
 
 	mModels[0]->GetModelParts(lcMatrix44Identity(), gDefaultColor, ModelParts);
 
+	// Exporters expect flattened meshes so add a part for each instanced primitive.
+	const size_t PartCount = ModelParts.size();
+
+	for (size_t PartIdx = 0; PartIdx < PartCount; PartIdx++)
+	{
+		const lcModelPartsEntry ModelPart = ModelParts[PartIdx];
+		const lcMesh* Mesh = !ModelPart.Mesh ? ModelPart.Info->GetMesh() : ModelPart.Mesh;
+
+		if (!Mesh)
+			continue;
+
+		for (const lcMeshInstance& Instance : Mesh->mInstances)
+			ModelParts.emplace_back(lcModelPartsEntry{ lcMul(Instance.Transform, ModelPart.WorldMatrix), ModelPart.Info, Instance.Mesh.get(), ModelPart.ColorIndex });
+	}
+
 	SetActiveModel(mModels.FindIndex(mActiveModel));
 
 	return ModelParts;
@@ -1109,12 +1129,14 @@ bool Project::Export3DStudio(const QString& FileName)
 
 		File.WriteU16(Mesh->mNumVertices);
 
-		lcVertex* Verts = (lcVertex*)Mesh->mVertexData;
-		const lcMatrix44& ModelWorld = ModelPart.WorldMatrix;
+		const lcVertex* Verts = Mesh->GetVertexData();
+		std::vector<lcVector3> Positions(Mesh->mNumVertices);
 
-		for (int VertexIdx = 0; VertexIdx < Mesh->mNumVertices; VertexIdx++)
+		if (!Positions.empty())
+			lcTransformPositions(ModelPart.WorldMatrix, &Verts[0].Position, sizeof(lcVertex), Positions.data(), sizeof(lcVector3), Positions.size());
+
+		for (const lcVector3& Pos : Positions)
 		{
-			lcVector3 Pos = lcMul31(Verts[VertexIdx].Position, ModelWorld);
 			File.WriteFloat(Pos[0]);
 			File.WriteFloat(Pos[1]);
 			File.WriteFloat(Pos[2]);
@@ -1351,6 +1373,9 @@ bool Project::ExportCOLLADA(const QString& FileName)
 		const PieceInfo* Info = ModelPart.Info;
 		QString ID = QString(Info->mFileName).replace('.', '_');
 
+		if (ModelPart.Mesh && (ModelPart.Mesh->mFlags & lcMeshFlag::Primitive))
+			ID = QLatin1String("primitive");
+
 		if (ModelPart.Mesh)
 			ID += "_" + QString::number((quintptr)ModelPart.Mesh, 16);
 
@@ -1996,7 +2021,10 @@ bool Project::ExportPOVRay(const QString& FileName)
 
 	auto GetMeshName = [](const lcModelPartsEntry& ModelPart, char (&Name)[LC_PIECE_NAME_LEN])
 	{
-		strcpy(Name, ModelPart.Info->mFileName);
+		if (ModelPart.Mesh && (ModelPart.Mesh->mFlags & lcMeshFlag::Primitive))
+			strcpy(Name, "primitive");
+		else
+			strcpy(Name, ModelPart.Info->mFileName);
 
 		for (char* c = Name; *c; c++)
 			if (*c == '-' || *c == '.')
@@ -2055,6 +2083,9 @@ bool Project::ExportPOVRay(const QString& FileName)
 
 	for (const lcModelPartsEntry& ModelPart : ModelParts)
 	{
+		if (ModelPart.Mesh && (ModelPart.Mesh->mFlags & lcMeshFlag::Primitive))
+			continue;
+
 		lcVector3 Points[8];
 		
 		lcGetBoxCorners(ModelPart.Info->GetBoundingBox(), Points);
@@ -2111,6 +2142,14 @@ bool Project::ExportPOVRay(const QString& FileName)
 		}
 		else
 		{
+			if (ModelPart.Mesh->mFlags & lcMeshFlag::Primitive)
+			{
+				const auto Search = PieceTable.find(ModelPart.Info);
+
+				if (Search != PieceTable.end() && (Search->second.second & (LGEO_PIECE_LGEO | LGEO_PIECE_AR)))
+					continue;
+			}
+
 			char Name[LC_PIECE_NAME_LEN];
 			GetMeshName(ModelPart, Name);
 
@@ -2182,12 +2221,14 @@ bool Project::ExportWavefront(const QString& FileName)
 		if (!Mesh)
 			continue;
 
-		const lcMatrix44& ModelWorld = ModelPart.WorldMatrix;
-		lcVertex* Verts = (lcVertex*)Mesh->mVertexData;
+		const lcVertex* Verts = Mesh->GetVertexData();
+		std::vector<lcVector3> Positions(Mesh->mNumVertices);
 
-		for (int VertexIdx = 0; VertexIdx < Mesh->mNumVertices; VertexIdx++)
+		if (!Positions.empty())
+			lcTransformPositions(ModelPart.WorldMatrix, &Verts[0].Position, sizeof(lcVertex), Positions.data(), sizeof(lcVector3), Positions.size());
+
+		for (const lcVector3& Vertex : Positions)
 		{
-			lcVector3 Vertex = lcMul31(Verts[VertexIdx].Position, ModelWorld);
 			sprintf(Line, "v %.2f %.2f %.2f\n", Vertex[0], Vertex[1], Vertex[2]);
 			OBJFile.WriteLine(Line);
 		}
@@ -2202,12 +2243,17 @@ bool Project::ExportWavefront(const QString& FileName)
 		if (!Mesh)
 			continue;
 
-		const lcMatrix44& ModelWorld = ModelPart.WorldMatrix;
-		lcVertex* Verts = (lcVertex*)Mesh->mVertexData;
+		const lcVertex* Verts = Mesh->GetVertexData();
+		std::vector<lcVector3> Normals(Mesh->mNumVertices);
 
 		for (int VertexIdx = 0; VertexIdx < Mesh->mNumVertices; VertexIdx++)
+			Normals[VertexIdx] = lcUnpackNormal(Verts[VertexIdx].Normal);
+
+		if (!Normals.empty())
+			lcTransformDirections(ModelPart.WorldMatrix, Normals.data(), sizeof(lcVector3), Normals.data(), sizeof(lcVector3), Normals.size());
+
+		for (const lcVector3& Normal : Normals)
 		{
-			lcVector3 Normal = lcMul30(lcUnpackNormal(Verts[VertexIdx].Normal), ModelWorld);
 			sprintf(Line, "vn %.2f %.2f %.2f\n", Normal[0], Normal[1], Normal[2]);
 			OBJFile.WriteLine(Line);
 		}
@@ -196,8 +196,11 @@ SOURCES += \
 	common/lc_library.cpp \
 	common/lc_lxf.cpp \
 	common/lc_mainwindow.cpp \
+	common/lc_math.cpp \
 	common/lc_mesh.cpp \
 	common/lc_meshloader.cpp \
+	common/lc_meshoptimizer.cpp \
+	common/lc_meshsimplifier.cpp \
 	common/lc_minifigdialog.cpp \
 	common/lc_model.cpp \
 	common/lc_modellistdialog.cpp \
@@ -270,9 +273,12 @@ HEADERS += \
 	common/lc_math.h \
 	common/lc_mesh.h \
 	common/lc_meshloader.h \
+	common/lc_meshoptimizer.h \
+	common/lc_meshsimplifier.h \
 	common/lc_minifigdialog.h \
 	common/lc_model.h \
 	common/lc_modellistdialog.h \
+	common/lc_nameindex.h \
 	common/lc_pagesetupdialog.h \
 	common/lc_previewwidget.h \
 	common/lc_profile.h \
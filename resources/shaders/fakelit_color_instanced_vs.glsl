@@ -0,0 +1,22 @@
+LC_VERTEX_INPUT vec3 VertexPosition;
+LC_VERTEX_INPUT vec3 VertexNormal;
+LC_VERTEX_INPUT vec4 InstanceWorldMatrix0;
+LC_VERTEX_INPUT vec4 InstanceWorldMatrix1;
+LC_VERTEX_INPUT vec4 InstanceWorldMatrix2;
+LC_VERTEX_INPUT vec4 InstanceWorldMatrix3;
+LC_VERTEX_INPUT vec4 InstanceColor;
+LC_VERTEX_OUTPUT vec3 PixelPosition;
+LC_VERTEX_OUTPUT vec3 PixelNormal;
+LC_VERTEX_OUTPUT vec4 PixelColor;
+
+uniform mat4 ViewProjectionMatrix;
+
+void main()
+{
+	mat4 WorldMatrix = mat4(InstanceWorldMatrix0, InstanceWorldMatrix1, InstanceWorldMatrix2, InstanceWorldMatrix3);
+	vec4 WorldPosition = WorldMatrix * vec4(VertexPosition, 1.0);
+	PixelPosition = WorldPosition.xyz;
+	PixelNormal = (WorldMatrix * vec4(VertexNormal, 0.0)).xyz;
+	PixelColor = InstanceColor;
+	gl_Position = ViewProjectionMatrix * WorldPosition;
+}
@@ -0,0 +1,19 @@
+LC_VERTEX_INPUT vec3 VertexPosition;
+LC_VERTEX_INPUT vec3 VertexNormal;
+LC_VERTEX_OUTPUT vec3 PixelPosition;
+LC_VERTEX_OUTPUT vec3 PixelNormal;
+LC_VERTEX_OUTPUT vec4 PixelColor;
+
+uniform mat4 ViewProjectionMatrix;
+uniform samplerBuffer ObjectData;
+uniform ivec2 ObjectOffsets;
+
+void main()
+{
+	mat4 WorldMatrix = mat4(texelFetch(ObjectData, ObjectOffsets.x), texelFetch(ObjectData, ObjectOffsets.x + 1), texelFetch(ObjectData, ObjectOffsets.x + 2), texelFetch(ObjectData, ObjectOffsets.x + 3));
+	vec4 WorldPosition = WorldMatrix * vec4(VertexPosition, 1.0);
+	PixelPosition = WorldPosition.xyz;
+	PixelNormal = (WorldMatrix * vec4(VertexNormal, 0.0)).xyz;
+	PixelColor = texelFetch(ObjectData, ObjectOffsets.y);
+	gl_Position = ViewProjectionMatrix * WorldPosition;
+}
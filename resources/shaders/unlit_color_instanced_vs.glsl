@@ -0,0 +1,16 @@
+LC_VERTEX_INPUT vec3 VertexPosition;
+LC_VERTEX_INPUT vec4 InstanceWorldMatrix0;
+LC_VERTEX_INPUT vec4 InstanceWorldMatrix1;
+LC_VERTEX_INPUT vec4 InstanceWorldMatrix2;
+LC_VERTEX_INPUT vec4 InstanceWorldMatrix3;
+LC_VERTEX_INPUT vec4 InstanceColor;
+LC_VERTEX_OUTPUT vec4 PixelColor;
+
+uniform mat4 ViewProjectionMatrix;
+
+void main()
+{
+	mat4 WorldMatrix = mat4(InstanceWorldMatrix0, InstanceWorldMatrix1, InstanceWorldMatrix2, InstanceWorldMatrix3);
+	gl_Position = ViewProjectionMatrix * (WorldMatrix * vec4(VertexPosition, 1.0));
+	PixelColor = InstanceColor;
+}
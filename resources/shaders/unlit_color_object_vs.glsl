@@ -0,0 +1,13 @@
+LC_VERTEX_INPUT vec3 VertexPosition;
+LC_VERTEX_OUTPUT vec4 PixelColor;
+
+uniform mat4 ViewProjectionMatrix;
+uniform samplerBuffer ObjectData;
+uniform ivec2 ObjectOffsets;
+
+void main()
+{
+	mat4 WorldMatrix = mat4(texelFetch(ObjectData, ObjectOffsets.x), texelFetch(ObjectData, ObjectOffsets.x + 1), texelFetch(ObjectData, ObjectOffsets.x + 2), texelFetch(ObjectData, ObjectOffsets.x + 3));
+	gl_Position = ViewProjectionMatrix * (WorldMatrix * vec4(VertexPosition, 1.0));
+	PixelColor = texelFetch(ObjectData, ObjectOffsets.y);
+}